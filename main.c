@@ -20,9 +20,23 @@
 #define CHUNK_SIZE 2048
 #define FFT_SIZE CHUNK_SIZE
 #define MAX_AMPLITUDE 32768.0 // Maximum value for a 16-bit signed integer
-#define DETECT_THRESHOLD 0.7   // A value from 0.0 to 1.0 for sine wave purity
+#define DETECT_SNR_DB 15.0     // Peak bin power over the local noise floor needed for a detection
+#define NOISE_FLOOR_HALFWIDTH 32 // Bins either side averaged into the local noise floor
+#define NOISE_FLOOR_CLIP 2.0   // Bins above this multiple of the floor are clipped on the next pass
+#define NOISE_FLOOR_PASSES 3   // Running-mean passes; later ones exclude the tones themselves
 #define FREQUENCY_TOLERANCE 5.0 // Tolerance in Hz to avoid flickering output
+#define TRACK_ALPHA 0.5         // Alpha-beta tracker gain on the frequency residual
+#define TRACK_BETA 0.17         // Alpha-beta tracker gain on the slope (near critical damping for TRACK_ALPHA)
+#define SWEEP_MAX_RATE 5000.0   // Fastest sweep in Hz/s a new track can be acquired at
+#define SWEEP_GATE_FRACTION 0.25 // Gate widening as a fraction of the predicted per-frame movement
+#define SWEEP_MIN_RATE 50.0     // Slopes below this (Hz/s) are reported as a steady tone
 #define PEAK_SUPPRESS_BINS 2    // Number of neighbouring bins to suppress around a detected peak
+#define SIDELOBE_RADIUS_FACTOR 8 // Sidelobe masking radius in multiples of the suppression radius
+#define SIDELOBE_REJECT_DB 30.0 // Peaks this far below a stronger one inside that radius are its sidelobes
+#define MAX_PEAK_CANDIDATES 32  // Peaks collected per frame before harmonic grouping
+#define MAX_HARMONIC 8          // Highest harmonic number grouped under a fundamental
+#define HARMONIC_MIN_BIN 8      // Lowest bin considered as a fundamental (coarser bins match too loosely)
+#define HARMONIC_TOLERANCE_BINS 1.0 // Allowed offset from n*f0 in bins, widened by 0.1 bin per harmonic
 #define SINE_WAVE_MIN_HZ 20
 #define SINE_WAVE_MAX_HZ 20000
 #define FONT_SIZE 12
@@ -38,26 +52,407 @@ static double pcm_buffer[CHUNK_SIZE];
 static fftw_complex* out;
 static fftw_plan p;
 static double freq_resolution;
-static double hann_window[FFT_SIZE];
+static double frame_seconds;            // Audio time between the starts of successive analysis frames
+static double noise_floor[FFT_SIZE / 2]; // Local noise floor per bin, in spectrum power units
 static double magnitudes[FFT_SIZE / 2]; // Stores normalized spectrum magnitudes for visualization
 static double avg_powers[FFT_SIZE / 2]; // Smoothed power spectrum when averaging filter is enabled
 static bool averaging_enabled = false;  // Toggle for averaging filter
 
+// Spectral estimators selectable with the W key
+enum {
+    SPECTRUM_PERIODOGRAM, // Single windowed FFT (window selectable with the N key)
+    SPECTRUM_WELCH,       // Overlapped half-length Hann segments, averaged
+    SPECTRUM_MULTITAPER,  // DPSS (Slepian) multitaper, averaged
+    SPECTRUM_POLYPHASE,   // Critically sampled polyphase filter-bank channelizer
+    SPECTRUM_MODE_COUNT
+};
+static const char* spectral_mode_names[SPECTRUM_MODE_COUNT] = {"periodogram", "welch", "multitaper", "polyphase"};
+static int spectral_mode = SPECTRUM_PERIODOGRAM;
+
+// Periodogram windows selectable with the N key. Each comes with constants
+// precomputed at plan time: coherent gain to put every window on the same
+// full-scale level, ENBW, the main-lobe half-width used for peak power and
+// purity, and a table undoing the bias of the peak interpolator
+enum {
+    WINDOW_HANN,
+    WINDOW_BLACKMAN_HARRIS, // 4-term, -92 dB sidelobes
+    WINDOW_FLAT_TOP,        // 5-term, amplitude flat to 0.01 dB across a bin
+    WINDOW_KAISER,          // Kaiser-Bessel with adjustable beta
+    WINDOW_CHEBYSHEV,       // Dolph-Chebyshev, equiripple sidelobes
+    WINDOW_COUNT
+};
+static const char* window_names[WINDOW_COUNT] = {"hann", "blackman-harris", "flat-top", "kaiser", "chebyshev"};
+static int window_type = WINDOW_HANN;
+static double kaiser_beta = 8.6;             // Sidelobes near -63 dB; larger trades resolution for leakage
+#define CHEBYSHEV_ATTENUATION_DB 100.0       // Dolph-Chebyshev sidelobe level
+#define WINDOW_LOBE_ENERGY 0.999             // Fraction of a tone's power inside the main-lobe half-width
+#define WINDOW_BIAS_POINTS 65                // Interpolation bias table resolution over +-0.5 bin
+#define WINDOW_RESPONSE_SPAN 8               // Bins either side evaluated when characterising a window
+
+typedef struct {
+    double coherent_gain; // Window mean: amplitude gain for a bin-centred tone
+    double enbw;          // Equivalent noise bandwidth in bins
+    int halfwidth;        // Bins either side holding WINDOW_LOBE_ENERGY of a tone's power
+    double bias[WINDOW_BIAS_POINTS]; // True offset for evenly spaced interpolated offsets in [-0.5, 0.5]
+} WindowInfo;
+static double window_tables[WINDOW_COUNT][FFT_SIZE];
+static WindowInfo window_info[WINDOW_COUNT];
+
+#define WELCH_SEGMENTS 3             // Half-length segments at 50% overlap span one frame
+#define WELCH_SEGMENT_SIZE (FFT_SIZE / 2)
+#define MULTITAPER_NW 3.0            // Time-half-bandwidth product of the DPSS tapers
+#define MULTITAPER_TAPERS 5          // 2NW - 1 well-concentrated tapers
+#define MAX_TAPERS 5
+
+// Bank of full-frame tapers transformed together by one batched FFTW plan.
+// Welch segments are stored as zero-extended Hann tapers so both averaged
+// estimators share the same layout and bin grid as the periodogram.
+typedef struct {
+    int count;            // Number of tapers (0 for the plain periodogram)
+    double* window;       // count * FFT_SIZE taper coefficients
+    double* in;           // count * FFT_SIZE tapered frames
+    fftw_complex* out;    // count * (FFT_SIZE / 2 + 1) spectra
+    fftw_plan plan;       // fftw_plan_many_dft_r2c over all tapers
+    double scale;         // Maps the averaged power onto the Hann periodogram's full-scale peak
+    double enbw;          // Equivalent noise bandwidth in bins of the averaged estimate
+    int peak_halfwidth;   // Bins either side of a peak bin covered by its main lobe
+} TaperBank;
+static TaperBank taper_banks[SPECTRUM_MODE_COUNT];
+
+#define POLYPHASE_TAPS 4             // Prototype length in frames (taps per polyphase branch)
+#define POLYPHASE_CHANNEL_WIDTH 1.2  // Prototype passband in channels; neighbours cross near -3 dB
+
+// Polyphase filter bank: a windowed-sinc prototype POLYPHASE_TAPS frames long
+// about one bin wide is folded onto FFT_SIZE branches, so each FFT bin
+// becomes a flat channel with far lower leakage than the Hann window gives
+typedef struct {
+    double* prototype;    // POLYPHASE_TAPS * FFT_SIZE prototype low-pass FIR
+    double* history;      // Ring of the last POLYPHASE_TAPS input frames
+    int newest;           // Ring slot holding the most recent frame
+    double scale;         // Maps channel power onto the Hann periodogram's full-scale peak
+    double enbw;          // Equivalent noise bandwidth of a channel in bins
+} PolyphaseBank;
+static PolyphaseBank polyphase;
+
+// Zero-padded peak location: the windowed frame is also transformed at
+// zero_pad times its length, and each in-band candidate is located on that
+// finer grid between its neighbouring bins. One plan per factor is made at
+// setup on shared buffers whose tail past the frame stays zero.
+#define ZERO_PAD_MAX 8
+#define ZERO_PAD_PLANS 4             // Factors 1 (no padding), 2, 4 and 8
+static int zero_pad = 1;
+static double* padded_in;            // ZERO_PAD_MAX * FFT_SIZE samples
+static fftw_complex* padded_out;     // ZERO_PAD_MAX * FFT_SIZE / 2 + 1 bins
+static fftw_plan padded_plans[ZERO_PAD_PLANS]; // Indexed by log2 of the factor
+static bool padded_ready = false;    // This frame has a padded spectrum
+static double padded_scale = 1.0;    // Power scale of the padded spectrum
+
+static int peak_halfwidth = 1; // Main-lobe half-width of the active estimator
+static double lobe_enbw = 1.5; // Equivalent noise bandwidth in bins of the active estimator
+static bool centroid_interpolation = false; // Locate peaks by lobe centroid instead of log-parabola
+static int suppress_bins = PEAK_SUPPRESS_BINS; // Peak suppression radius, widened for broad lobes
+
+// Automatic decimation: when the band-pass upper edge allows it, the input is
+// run through a cascade of half-band FIR decimators so each FFT covers only
+// the band of interest, with finer bins and FFTs needed only every few chunks
+#define HALFBAND_SIDE_TAPS 12        // Non-zero taps either side of the centre tap
+#define HALFBAND_LENGTH (4 * HALFBAND_SIDE_TAPS - 1) // 47-tap half-band filter
+#define HALFBAND_KAISER_BETA 10.0    // About -99 dB over the alias band [0.325, 0.5] of the input rate
+#define DECIMATION_MAX_STAGES 4      // Up to 16x decimation
+#define DECIMATION_PASSBAND 0.35     // Highest band edge as a fraction of the decimated rate
+
+typedef struct {
+    double buf[HALFBAND_LENGTH + CHUNK_SIZE]; // Filter history followed by new input
+    int len;
+} HalfbandStage;
+
+static double halfband_taps[HALFBAND_SIDE_TAPS]; // Odd-offset taps; the centre tap is 0.5
+static HalfbandStage decimators[DECIMATION_MAX_STAGES];
+static int decimation_stages = 0;        // Active stages; analysis rate is SAMPLE_RATE >> stages
+static double analysis_samples[FFT_SIZE + CHUNK_SIZE]; // Analysis-rate samples awaiting a full frame
+static int analysis_len = 0;
+
+// Multithreaded FFTW: plans of at least fft_threads_min_size points are
+// split across threads, each thread getting at least half that many points;
+// smaller plans stay on the calling thread. `--bench-fft` measures where the
+// crossover lies on a given machine.
+#define FFT_THREADS_MIN_SIZE (1 << 17)
+static int fft_threads_min_size = FFT_THREADS_MIN_SIZE;
+static bool fft_threads_ready = false; // fftw_init_threads succeeded
+
+// Fixed-point path for the periodogram: Sint16 input times a Q15 window,
+// a radix-2 integer FFT on int32 data with Q30 twiddles (the real frame is
+// packed into a half-length complex transform and split afterwards) and
+// int64 power accumulation. Only the detection stages see floating point.
+// It skips the prefilter, decimation, overlap, zero padding and the low band.
+#define FIXED_FFT_POINTS (FFT_SIZE / 2)       // Complex points after packing pairs of samples
+#define FIXED_FFT_BITS 10                     // log2(FIXED_FFT_POINTS)
+#define Q15_ONE 32767
+#define Q30_ONE 1073741823
+#define FIXED_FRACTION_BITS 4                 // Bits kept below the input LSB after windowing
+static bool fixed_point = false;
+static Sint16 fixed_windows[WINDOW_COUNT][FFT_SIZE]; // Q15 copies of window_tables
+static double fixed_window_scale[WINDOW_COUNT];      // Factor applied to keep each copy's mean at most 1/2
+static Sint32 fixed_twiddle[FFT_SIZE / 2][2];        // Q30 cos and -sin of 2*pi*k/FFT_SIZE
+static int fixed_bitrev[FIXED_FFT_POINTS];
+
+// Overlapping frames: successive frames start FFT_SIZE / frame_overlap
+// analysis samples apart, so the tracker is updated more often than the
+// frame length allows. All frames that become ready in one callback are
+// windowed into one contiguous buffer and transformed by a single batched
+// FFTW plan; the batch size follows the overlap and decimation settings.
+#define FRAME_OVERLAP_MAX 4          // Also the largest batch a callback can produce
+static int frame_overlap = 1;
+static double* batch_in;             // FRAME_OVERLAP_MAX windowed frames
+static fftw_complex* batch_out;      // FRAME_OVERLAP_MAX spectra of FFT_SIZE / 2 + 1 bins
+static fftw_plan batch_plans[FRAME_OVERLAP_MAX]; // Indexed by batch size - 1
+
+// Multi-frame integration for weak tones: detection runs once per block of
+// INTEGRATION_FRAMES frames on the block's mean power spectrum. Only every
+// frame_overlap-th frame is taken, so the block's frames do not overlap and
+// their noise is independent. Averaging narrows the noise distribution, so
+// the incoherent SNR threshold is lowered to keep the single-frame
+// false-alarm rate. The coherent mode also sums the complex bin of each
+// candidate peak across the block, rotated back by the phase a tone at each
+// of INTEGRATION_HYPOTHESES offsets inside the bin advances between the
+// block's frames; a steady tone then gains INTEGRATION_FRAMES in power
+// over the noise. Candidates are the live tracks and the strongest peaks of
+// the previous block, so the state is one power sum and a few accumulators
+// rather than stored frames. Estimators without a complex spectrum (the
+// averaged ones and the fixed-point path) only integrate incoherently.
+enum {
+    INTEGRATION_OFF,
+    INTEGRATION_COHERENT,   // Phase-aligned candidate sums with incoherent fallback
+    INTEGRATION_INCOHERENT, // Block mean of the power spectra only
+    INTEGRATION_MODE_COUNT
+};
+static const char* integration_mode_names[INTEGRATION_MODE_COUNT] = {"off", "coherent", "incoherent"};
+static int integration_mode = INTEGRATION_OFF;
+#define INTEGRATION_FRAMES 8        // Frames per detection block
+#define INTEGRATION_CANDIDATES 16   // Bins integrated coherently per block
+#define INTEGRATION_HYPOTHESES (2 * INTEGRATION_FRAMES) // Offsets across a bin; under 1 dB loss between them
+
+typedef struct {
+    int bin;
+    double sum[INTEGRATION_HYPOTHESES][2]; // Phase-aligned sum of the bin per offset
+} CoherentCandidate;
+
+static double integration_sum[FFT_SIZE / 2];     // Power summed over the current block
+static CoherentCandidate coherent_candidates[INTEGRATION_CANDIDATES];
+static int coherent_count = 0;
+static int integration_count = 0;                // Frames in the current block
+static int integration_skip = 0;                 // Overlapping frames left before the next one is taken
+static double integration_snr = 1.0;             // Incoherent SNR threshold (linear) for the block mean
+
+// Tracked-bin fast path: once tones are locked, most frames search only
+// windows around the live tracks' predicted bins (their gates, plus their
+// harmonics when they have any) for peaks and for the noise reference. A
+// full acquisition scan runs every ACQUISITION_INTERVAL frames, when the
+// total power moves ACQUISITION_ENERGY_DB from the last scan, and whenever
+// no track is live, so new tones are still found within a fraction of a
+// second. Integration has its own block schedule and always scans in full.
+#define ACQUISITION_INTERVAL 16      // Frames between full scans at most
+#define ACQUISITION_ENERGY_DB 3.0    // Total power change that forces a full scan
+#define MAX_SEARCH_RANGES (MAX_TRACKED_SINES * MAX_HARMONIC)
+typedef struct {
+    int lo, hi;                      // Inclusive bin range
+} BinRange;
+static bool tracked_search = false;
+static int frames_since_scan = 0;
+static double scan_power = 0.0;      // Total power at the last full scan
+static double candidate_floor = 0.0; // Weakest candidate of the last full scan if it filled the list
+static Uint64 full_scans = 0, tracked_frames = 0, tracked_bins = 0; // Benchmark counters
+
+// Block-max pyramid over a spectrum: level 0 holds the maximum of each
+// PYRAMID_FANOUT consecutive bins and every level above the maximum of
+// PYRAMID_FANOUT blocks below, up to a single block. It is built in one pass
+// over the bins (the upper levels add 1/(PYRAMID_FANOUT - 1) of that). The
+// peak search uses it to jump over blocks that cannot hold a bin above its
+// threshold, and the display to take the maximum over each pixel column.
+#define PYRAMID_FANOUT 8
+#define PYRAMID_MAX_LEVELS 8             // Enough for 16M bins
+#define PYRAMID_STORAGE (FFT_SIZE / 2 / (PYRAMID_FANOUT - 1) + PYRAMID_MAX_LEVELS)
+typedef struct {
+    const double* values;                // The bins, which the pyramid does not own
+    int n;
+    int levels;
+    int offset[PYRAMID_MAX_LEVELS];      // Start of each level in blocks[]
+    double blocks[PYRAMID_STORAGE];
+} MaxPyramid;
+static MaxPyramid peak_pyramid;
+
+// Time-domain band-pass prefilter: a 4th-order Butterworth high-pass at the
+// lower cutoff followed by a 4th-order low-pass at the upper cutoff. The four
+// biquad sections run in lockstep, section k working on sample n-k, so one
+// sample step is a single 4-wide vector update (at the cost of 3 samples delay)
+#define BIQUAD_SECTIONS 4
+
+typedef struct {
+    double b0[BIQUAD_SECTIONS], b1[BIQUAD_SECTIONS], b2[BIQUAD_SECTIONS];
+    double a1[BIQUAD_SECTIONS], a2[BIQUAD_SECTIONS];
+} BiquadCoeffs;
+
+typedef struct {
+    BiquadCoeffs c;
+    double z1[BIQUAD_SECTIONS], z2[BIQUAD_SECTIONS]; // Transposed direct form II state
+    double y[BIQUAD_SECTIONS];                       // Latest output of each section
+} BiquadCascade;
+
+static BiquadCascade prefilter;
+
+// Low-band pitch path: below LOWBAND_MAX_HZ full-rate FFT bins are too coarse
+// (21.5 Hz), so the prefiltered input is also decimated 32x, band-limited
+// and run through YIN, whose estimates go straight to the tracker. The FFT
+// path leaves that band alone while its bins are coarser than
+// LOWBAND_FFT_RESOLUTION_HZ; automatic decimation makes it fine enough.
+#define LOWBAND_STAGES 5               // Half-band stages: 44.1 kHz -> 1378 Hz
+#define LOWBAND_MAX_HZ 100.0           // Upper edge of the YIN band
+#define LOWBAND_CUTOFF_HZ 150.0        // Low-pass applied after decimation
+#define LOWBAND_HIGHPASS_HZ 10.0       // Removes DC before the difference function
+#define LOWBAND_FFT_RESOLUTION_HZ 5.0  // FFT bins this fine cover the low band themselves
+#define LOWBAND_WINDOW 256             // YIN integration window (186 ms)
+#define LOWBAND_MAX_LAG 72             // Longest period searched, just over 20 Hz
+#define LOWBAND_LENGTH (LOWBAND_WINDOW + LOWBAND_MAX_LAG)
+#define LOWBAND_FFT 512                // Correlation FFT size; no wrap for lags up to LOWBAND_MAX_LAG
+#define LOWBAND_MIN_RMS 1e-3           // Level below which the low band is treated as silent
+#define YIN_THRESHOLD 0.15             // Cumulative-mean-normalised difference accepting a period
+#define LOWBAND_ENERGY_FRACTION 0.5    // Share of the window's energy that must lie in the YIN band
+
+typedef struct {
+    HalfbandStage stages[LOWBAND_STAGES];
+    BiquadCascade filter;
+    double samples[LOWBAND_LENGTH];    // Most recent decimated samples, oldest first
+    int count;
+    double* x;                         // LOWBAND_FFT correlation inputs and output
+    double* y;
+    double* r;
+    fftw_complex* x_spec;
+    fftw_complex* y_spec;
+    fftw_plan x_plan, y_plan, r_plan;
+} LowbandPitch;
+static LowbandPitch lowband;
+
+// Pipeline stages timed by the headless benchmark (--bench)
+enum {
+    STAGE_CONVERT,
+    STAGE_PREFILTER,
+    STAGE_DTMF,
+    STAGE_COUNTER,
+    STAGE_DEMOD,
+    STAGE_FFT,
+    STAGE_SPECTRUM,
+    STAGE_NORMALIZE,
+    STAGE_PREDICT,
+    STAGE_PEAKS,
+    STAGE_HARMONICS,
+    STAGE_DETECT,
+    STAGE_LOWBAND,
+    STAGE_AGEING,
+    STAGE_COUNT
+};
+static const char* stage_names[STAGE_COUNT] = {
+    "convert", "prefilter", "dtmf", "counter", "demod", "fft", "spectrum", "normalize", "predict", "peaks", "harmonics", "detect", "lowband", "ageing"
+};
+#define BENCH_DEFAULT_FRAMES 2000
+#define FFT_BENCH_MIN_LOG2 14           // --bench-fft sizes: 16k ...
+#define FFT_BENCH_MAX_LOG2 20           // ... to 1M points
+#define FFT_BENCH_SECONDS 0.25          // Minimum timing run per size and thread count
+#define FIXED_BENCH_HZ 1000.3           // --bench-fixed test tone, between bins
+#define FIXED_BENCH_QUIET_DB -61.0      // Level of the quiet test tone in dBFS
+#define VARIANCE_BENCH_EDGE 16          // --bench-variance ignores this many bins at each end
+static bool bench_mode = false;
+static Uint64 stage_ticks[STAGE_COUNT]; // Accumulated performance counter ticks per stage
+static Uint64 bench_samples = 0;        // Synthesised samples; the benchmark's track clock
+
 static SDL_Window* window = NULL;
 static SDL_Renderer* renderer = NULL;
 static TTF_Font* font = NULL;
 
-// Sine tracking structure
-#define MAX_TRACKED_SINES 5
+// Sine tracking state, stored as one array per field (structure of arrays)
+// indexed by track slot. Association and ageing then read each field as a
+// contiguous vector, and their per-slot passes are branch-free so the
+// compiler vectorises them; the whole set still copies as one struct.
+#define MAX_TRACKED_SINES 16
+typedef struct {
+    double freq[MAX_TRACKED_SINES];
+    double purity[MAX_TRACKED_SINES];
+    Uint32 start_time[MAX_TRACKED_SINES];     // 0 for a free slot
+    Uint32 last_seen[MAX_TRACKED_SINES];
+    int harmonics[MAX_TRACKED_SINES];         // Number of harmonic peaks grouped under this tone
+    double level_db[MAX_TRACKED_SINES];       // Amplitude of the latest measurement in dBFS, after manual gain (AGC gain removed)
+    double peak_db[MAX_TRACKED_SINES];        // Highest level_db since the track started (peak hold)
+    double snr_db[MAX_TRACKED_SINES];         // Latest peak bin power over the local noise estimate
+    double rate[MAX_TRACKED_SINES];           // Estimated sweep rate in Hz/s (alpha-beta slope state)
+    double predicted[MAX_TRACKED_SINES];      // Frequency predicted for the current frame
+    int predicted_bin[MAX_TRACKED_SINES];     // Strongest bin near the prediction this frame, or -1
+    int updates[MAX_TRACKED_SINES];           // Measurements absorbed since the track started
+    Uint32 last_frame[MAX_TRACKED_SINES];     // Analysis frame of the last measurement, modulo 2^32
+    Uint8 active[MAX_TRACKED_SINES];          // Promoted past the persistence threshold; a byte so ageing vectorises
+} SineTracks;
+
+// Spectral peak candidate produced by the peak search
+typedef struct {
+    int bin;
+    int rank;           // Position in descending bin-power order
+    double bin_power;   // Power of the peak bin alone
+    double power;       // Power summed over the peak's main lobe
+    double freq;        // Bin centre frequency
+    double interp_freq; // Parabolically interpolated frequency used for harmonic matching
+    int fundamental;    // Index of the peak this one is a harmonic of, or -1
+    int harmonics;      // Number of harmonics grouped under this peak
+    double group_power; // Power of this peak plus its grouped harmonics
+} SpectralPeak;
+
+static SineTracks tracks;
+
+// Per-track complex demodulators: each active track low-passes the
+// prefiltered full-rate input, mixed down by its frequency, and decimates
+// the result 64x in a single polyphase step. Only the kept outputs are
+// computed, each as a dot product of the shared input history with the
+// prototype low-pass modulated to the mixing frequency, then rotated back by
+// the oscillator phase at that output. The 689 Hz complex stream gives
+// instantaneous amplitude (twice |z|) and frequency (the mixing frequency
+// plus the phase step), fine enough to see FM wobble and dropouts a frame
+// smears out. Only active tracks are run, so the cost follows the tone
+// count. The taps are remodulated, and the oscillator restarted, only when
+// the track moves more than DEMOD_RETUNE_HZ.
+#define DEMOD_DECIMATION 64            // 44.1 kHz -> 689 Hz
+#define DEMOD_TAPS 640                 // Kaiser low-pass: +-212 Hz passband, 60 dB down from 477 Hz
+#define DEMOD_KAISER_BETA 6.0
+#define DEMOD_STOP_HZ 477.0            // Offset from the oscillator beyond which a tone is rejected
+#define DEMOD_HISTORY 256              // Instantaneous samples kept per track (372 ms)
+#define DEMOD_SETTLE (DEMOD_TAPS / DEMOD_DECIMATION + 1) // Outputs discarded after a restart
+#define DEMOD_RETUNE_HZ 100.0          // Track movement that re-centres the oscillator
+#define DEMOD_ENVELOPE_MS 50.0         // Time constant of the reference envelope
+#define DEMOD_DROPOUT_DB 12.0          // Envelope drop below the reference that counts as a dropout
+#define DEMOD_RECOVER_DB 6.0           // Recovery level that ends a dropout
+#define DEMOD_DROPOUT_MIN_MS 10.0      // Shorter dips, such as beat nulls, are not dropouts
+
 typedef struct {
-    double freq;
-    double purity;
-    Uint32 start_time;
-    Uint32 last_seen;
-    bool active;
-} SineTrack;
-
-static SineTrack tracks[MAX_TRACKED_SINES];
+    Uint32 start_time;                 // Track this demodulator follows; 0 when idle
+    double mix_hz;                     // Oscillator frequency
+    double phase;                      // Oscillator phase at the next output, in cycles
+    double taps_re[DEMOD_TAPS], taps_im[DEMOD_TAPS]; // Prototype modulated to mix_hz
+    int settle;                        // Outputs still to discard
+    bool crowded;                      // Another tone or an image is inside the stopband edge
+    double prev_i, prev_q;
+    double envelope;                   // Slow reference amplitude for dropout detection
+    double freq[DEMOD_HISTORY];        // Instantaneous frequency (Hz), ring buffer
+    double amplitude[DEMOD_HISTORY];   // Instantaneous amplitude (linear full scale)
+    int head, count;
+    double fm_rms_hz;                  // RMS deviation of the frequency over the history
+    double fm_peak_hz;                 // Largest deviation over the history
+    bool in_dropout;
+    int dropout_samples;
+    int dropouts;                      // Dropouts since the track started
+    double last_dropout_ms;
+} TrackDemod;
+static TrackDemod demods[MAX_TRACKED_SINES];
+static bool demod_enabled = false;
+static double demod_prototype[DEMOD_TAPS];               // Unit-DC-gain low-pass
+static double demod_input[DEMOD_TAPS - 1 + CHUNK_SIZE];  // Input history then the current chunk
+static int demod_next = 0;                               // Chunk offset of the next kept output
+static Uint64 analysis_frame = 0; // Frames analysed in sine mode; the tracker's clock
 static bool keep_running = true;
 
 // Logging support
@@ -76,6 +471,43 @@ static int log_count = 0;
 static int persistence_threshold_ms = 200; // default 0.2s
 // Input gain control (dB)
 static double input_gain_db = 0.0; // 0 dB default
+// Automatic gain control, used instead of input_gain_db while enabled. A
+// chunk is complete before it is converted, so its peak is known ahead of
+// its samples: an envelope of chunk peaks rises with agc_attack_ms and
+// falls with agc_release_ms, and the gain brings it to agc_target_db. The
+// gain ramps linearly across each chunk, so frames spanning chunks see no
+// steps, unless the ramp would lift the chunk's peak past AGC_CEILING_DB;
+// then the whole chunk takes the lower gain. Samples at full scale on the
+// input, or pushed past it by the gain, are counted as clipped.
+#define AGC_MIN_GAIN_DB -20.0
+#define AGC_MAX_GAIN_DB 60.0
+#define AGC_CEILING_DB -0.1            // Highest peak a chunk may reach after the gain
+#define CLIP_LEVEL 32767               // Input samples this large are clipped at the source
+static bool agc_enabled = false;
+static double agc_target_db = -12.0;   // Peak envelope level the gain aims for, in dBFS
+static double agc_attack_ms = 10.0;
+static double agc_release_ms = 1000.0;
+static double agc_envelope_db = -120.0;
+static double agc_gain_db = 0.0;       // AGC gain at the end of the latest chunk
+static double chunk_gain_db = 0.0;     // Effective gain of the latest chunk
+static double frame_gain_db = 0.0;     // Effective gain of the latest analysis frame
+static Uint64 clipped_samples = 0;
+static Uint32 last_clip_time = 0;      // Audio clock of the latest clipped chunk
+// Silence gate: the conversion pass also measures each chunk's peak and RMS
+// level. While the raw peak, before any gain, stays under silence_gate_db and
+// no track is alive, the band-pass, FFT and detection stages are skipped;
+// tracks still age out. Reading the raw level keeps the floor independent of
+// the manual gain and of the gain mode.
+#define SILENCE_GATE_MIN_DB -120.0   // Floor at which the gate is effectively off
+#define SILENCE_GATE_HOLD_CHUNKS 4   // Quiet chunks needed before the gate closes
+static double silence_gate_db = -70.0; // Raw input peak level (dBFS) treated as silence
+static double input_raw_peak_db = SILENCE_GATE_MIN_DB; // Peak of the latest chunk before any gain
+static double input_peak_db = SILENCE_GATE_MIN_DB; // Level of the latest chunk, after manual gain only
+static double input_rms_db = SILENCE_GATE_MIN_DB;
+static int quiet_chunks = 0;           // Consecutive chunks under the gate
+static bool gate_closed = false;
+static Uint64 gate_chunks = 0;         // Chunks seen in sine mode
+static Uint64 gate_skipped = 0;        // Chunks the gate skipped
 // Band-pass filter settings
 static double bandpass_low_hz = SINE_WAVE_MIN_HZ;
 static double bandpass_high_hz = SINE_WAVE_MAX_HZ;
@@ -83,19 +515,281 @@ static double bandpass_high_hz = SINE_WAVE_MAX_HZ;
 static bool squelch_enabled = false;
 static double squelch_threshold = 0.02; // normalized 0.0-1.0
 
+// Analysis modes selectable with the M key
+enum {
+    ANALYSIS_SINE, // FFT peak search and sine tracking
+    ANALYSIS_DTMF, // Goertzel-bank DTMF / dual-tone signalling decoder
+    ANALYSIS_COUNTER, // Zero-crossing frequency counter for a single tone
+    ANALYSIS_MODE_COUNT
+};
+static const char* analysis_mode_names[ANALYSIS_MODE_COUNT] = {"sine", "dtmf", "counter"};
+static int analysis_mode = ANALYSIS_SINE;
+
+// Peak detectors selectable with the T key. The CFAR detectors estimate the
+// noise from training cells either side of the peak, skipping guard cells
+// that hold its main lobe, and scale the threshold for a fixed false-alarm
+// probability, so detection does not depend on the gain. Bins zeroed by the
+// squelch are left out of every noise estimate; with none left, the squelch
+// level stands in, since the noise it removed lay below it
+enum {
+    DETECTOR_LOCAL_SNR, // Bin power over the clipped running-mean noise floor
+    DETECTOR_CA_CFAR,   // Cell-averaging CFAR: mean of the training cells
+    DETECTOR_OS_CFAR,   // Ordered-statistic CFAR: 3/4 rank of the training cells
+    DETECTOR_MODE_COUNT
+};
+static const char* detector_mode_names[DETECTOR_MODE_COUNT] = {"snr", "ca-cfar", "os-cfar"};
+static int detector_mode = DETECTOR_LOCAL_SNR;
+#define CFAR_TRAINING_CELLS 16 // Training cells on each side; guard cells follow suppress_bins
+#define CFAR_PFA 1e-6          // False-alarm probability per bin for exponential (periodogram) noise
+static double cfar_prefix[FFT_SIZE / 2 + 1]; // Running sums of the in-band spectrum
+static int cfar_live[FFT_SIZE / 2 + 1];      // Running counts of its bins the squelch left
+static double cfar_ca_alpha[2 * CFAR_TRAINING_CELLS + 1]; // Threshold factors by training cell count
+static double cfar_os_alpha[2 * CFAR_TRAINING_CELLS + 1];
+static double cfar_os_mean[2 * CFAR_TRAINING_CELLS + 1];  // Expected ordered statistic over the noise mean
+// The same for block means of INTEGRATION_FRAMES frames, whose noise bins
+// are gamma distributed with shape INTEGRATION_FRAMES
+static double cfar_block_ca_alpha[2 * CFAR_TRAINING_CELLS + 1];
+static double cfar_block_os_alpha[2 * CFAR_TRAINING_CELLS + 1];
+static double cfar_block_os_mean[2 * CFAR_TRAINING_CELLS + 1];
+#define CFAR_BLOCK_STEPS 2000 // Simpson intervals for the block OS false-alarm integral
+static int detect_lo, detect_hi;              // In-band bin range of the current frame
+
+// DTMF decoder settings
+#define DTMF_FRAME_SIZE 588          // 13.3 ms Goertzel frames at 44.1 kHz (75 Hz resolution)
+#define DTMF_MIN_LEVEL 0.01          // Minimum amplitude of each tone (about -40 dBFS)
+#define DTMF_ENERGY_RATIO 0.6        // Fraction of frame energy the tone pair must hold
+#define DTMF_RELATIVE_PEAK 6.3       // Strongest tone must beat the rest of its group by ~8 dB
+#define DTMF_NORMAL_TWIST_DB 8.0     // Max dB the high group may sit below the low group
+#define DTMF_REVERSE_TWIST_DB 4.0    // Max dB the high group may sit above the low group
+#define DTMF_MAX_PENDING 32          // Digits buffered between the audio thread and the UI
+#define DTMF_HISTORY 32              // Digits kept for the on-screen history
+
+typedef struct {
+    double s1[8];       // Goertzel state per frequency
+    double s2[8];
+    double energy;      // Sum of squares over the current frame
+    int count;          // Samples accumulated in the current frame
+    char last;          // Digit seen in the previous frame, or 0
+    char held;          // Digit currently reported, or 0
+} DtmfDecoder;
+
+static const double dtmf_freqs[8] = {697.0, 770.0, 852.0, 941.0, 1209.0, 1336.0, 1477.0, 1633.0};
+static const char dtmf_keys[4][4] = {
+    {'1', '2', '3', 'A'},
+    {'4', '5', '6', 'B'},
+    {'7', '8', '9', 'C'},
+    {'*', '0', '#', 'D'}
+};
+static double dtmf_coeff[8];
+static DtmfDecoder dtmf;
+
+// Frequency counter for channels carrying a single tone. After a DC blocker,
+// a Schmitt trigger at a fraction of the last chunk's peak picks one rising
+// zero crossing per period, located between samples by linear interpolation
+// as the last crossing before the signal clears the upper level. Once a
+// window spans COUNTER_MIN_CYCLES periods and COUNTER_WINDOW_MS, its cycle
+// count over the time between its first and last crossing is the frequency,
+// reported once per chunk. The spread of the periods rejects mixtures and
+// gives the SNR: noise of RMS s on a tone of amplitude A moves a crossing by
+// s / (2 pi f A), so a period spread sigma_T means SNR = 1 / (2 pi f sigma_T)^2.
+#define COUNTER_DC_HZ 5.0          // DC blocker corner
+#define COUNTER_HYSTERESIS 0.2     // Arming level as a fraction of the previous chunk's peak
+#define COUNTER_MIN_LEVEL 1e-3     // Peak below which the input is treated as silent (-60 dBFS)
+#define COUNTER_MIN_CYCLES 4
+#define COUNTER_WINDOW_MS 10.0
+#define COUNTER_MAX_JITTER 0.05    // Period spread, as a fraction of the period, that still counts as one tone
+
+typedef struct {
+    double x1, y1;          // DC blocker state
+    double prev;            // Previous blocked sample
+    double threshold;       // Arming level below zero, and trigger level above it
+    bool armed;
+    double crossing;        // Latest rising zero crossing while armed
+    bool started;           // The window has its first crossing
+    Uint64 position;        // Samples counted so far
+    double first, last;     // First and latest crossing of the window, in samples
+    int cycles;             // Periods between them
+    double period_sum, period_sq;
+    double energy;          // Sum of squares since the first crossing
+    int energy_count;
+} FreqCounter;
+static FreqCounter counter;
+static char dtmf_pending[DTMF_MAX_PENDING]; // Digits decoded but not yet logged
+static int dtmf_pending_count = 0;
+
 // --- Function Prototypes ---
 void log_error(const char* msg);
 void audio_callback(void* userdata, Uint8* stream, int len);
 void render_text(const char* text, int x, int y, SDL_Color color);
 void add_log_line(const char* text, SDL_Color color, Uint32 expire_time, int track_id);
 void prune_expired_logs(Uint32 now);
-void update_track(double freq, double purity, Uint32 now);
+void update_track(double freq, double purity, int harmonics, double level_db, double snr_db, Uint32 now);
+void track_measure(int i, double freq, double purity, int harmonics, double level_db, double snr_db, Uint32 now);
+void track_gates(double* gate);
+void predict_tracks(const double* powers, int n);
+int find_peaks(const MaxPyramid* pyramid, const BinRange* ranges, int range_count, double min_power, SpectralPeak* peaks,
+               int max_peaks);
+void build_max_pyramid(MaxPyramid* p, const double* values, int n);
+int pyramid_next_above(const MaxPyramid* p, int i, int hi, double threshold);
+double pyramid_max(const MaxPyramid* p, int lo, int hi);
+int search_ranges(double total_power, BinRange* ranges);
+int merge_ranges(BinRange* ranges, int count, int widen, int lo, int hi);
+void measure_peak(const double* powers, SpectralPeak* peak);
+void group_harmonics(SpectralPeak* peaks, int count);
+void estimate_noise_floor(const double* powers, int lo, int hi, double* floor_out);
+double peak_snr(const SpectralPeak* peak);
+double squelch_power(void);
+double peak_noise(const double* powers, const SpectralPeak* peak);
+void peak_level(const double* powers, const SpectralPeak* peak, double* level_db, double* snr_db);
+double cfar_statistic(const double* powers, int bin, int* cells);
+void setup_cfar(void);
+void setup_block_cfar(void);
+double gamma_tail(int shape, double x);
+double gamma_cdf(int shape, double x);
+int cfar_rank(int n);
+double select_kth(double* values, int n, int k);
+double cfar_threshold(const double* powers, int bin);
+bool peak_detected(const double* powers, const SpectralPeak* peak);
+bool setup_fft(void);
+bool setup_taper_bank(TaperBank* bank, int count);
+bool dpss_tapers(int n, double nw, int count, double* tapers);
+void estimate_tapered_spectrum(TaperBank* bank, const double* samples, double* powers);
+void set_spectral_mode(int mode);
+bool setup_windows(void);
+bool setup_zero_padding(void);
+int zero_pad_index(int factor);
+double padded_offset(int bin);
+double bessel_i0(double x);
+double chebyshev_poly(int order, double x);
+double lobe_offset(const double* powers, int bin, int halfwidth, bool centroid);
+void window_response(const double* win, double offset, double* response);
+void set_window(int type);
+bool setup_polyphase(void);
+void polyphase_frame(const double* samples);
+void setup_halfband(void);
+int decimation_stages_for(double high_hz);
+void configure_decimation(int stages);
+int halfband_decimate(HalfbandStage* st, const double* in, int count, double* out);
+int gather_frames(const double* samples);
+int frame_hop(void);
+bool setup_frame_batches(void);
+int fft_threads_for(int n);
+void setup_fixed_point(void);
+bool fixed_path_active(void);
+void fixed_point_chunk(const Sint16* samples, double gain, Uint64* mark);
+void fixed_fft(Sint32* re, Sint32* im);
+void fixed_spectrum(const Sint16* samples, double level_scale, double* powers);
+void plan_threads_for(int n);
+void analyse_frame(const fftw_complex* spec, double spectrum_scale, double* powers, Uint32 now, Uint64* mark);
+void setup_integration(void);
+void reset_integration(void);
+bool integrate_frame(const fftw_complex* spec, double spectrum_scale, const double* powers);
+void coherent_detections(const double* powers, double total_power, const SpectralPeak* peaks, int peak_count,
+                         bool* claimed, double low_hz, Uint32 now);
+void start_integration_block(const SpectralPeak* peaks, int peak_count, double low_hz);
+void add_coherent_candidate(int bin, int lo, int hi);
+double detection_seconds(void);
+void design_bandpass(double low_hz, double high_hz, double rate, BiquadCoeffs* c);
+void biquad_filter(BiquadCascade* f, const double* in, double* out, int count);
+bool setup_lowband(void);
+void lowband_push(const double* chunk);
+bool lowband_pitch(double* freq, double* periodicity, double* rms);
+bool lowband_active(void);
+void update_bandpass(void);
+void chunk_gain(const Sint16* samples, double* start, double* end);
+double meter_gain(void);
+void convert_chunk(const Sint16* samples, double gain_start, double gain_end, double* out);
+bool silence_gate(void);
+void reopen_gate(void);
+void age_tracks(Uint32 now);
+void stage_mark(int stage, Uint64* mark);
+Uint32 audio_ticks(void);
+int run_benchmark(int frames, int mode);
+int run_fft_benchmark(void);
+int next_thread_count(int threads, int cores);
+int run_fixed_benchmark(int frames);
+int run_variance_benchmark(int frames);
+void fixed_bench_errors(const Sint16* samples, double* peak_db, double* other_db);
+void dtmf_init(void);
+void dtmf_process(DtmfDecoder* d, const Sint16* samples, int count, double gain);
+char dtmf_classify(const DtmfDecoder* d);
+void counter_process(FreqCounter* c, const Sint16* samples, int count, double gain, Uint32 now);
+void demodulate_tracks(const double* samples);
+void setup_demod(void);
+void retune_demod(TrackDemod* d);
+bool demod_crowded(int track, double mix_hz);
+void demodulate_track(TrackDemod* d, int first);
 void cleanup();
 void sdl_log_filter(void* userdata, int category, SDL_LogPriority priority, const char* message);
 void save_config(void);
 void load_config(void);
 
 int main(int argc, char* argv[]) {
+    // Headless benchmark: feed a synthetic workload through audio_callback
+    // without opening a window or audio device
+    if (argc > 1 && strcmp(argv[1], "--bench-fft") == 0) {
+        return run_fft_benchmark();
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-fixed") == 0) {
+        int frames = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_FRAMES;
+        return run_fixed_benchmark(frames > 0 ? frames : BENCH_DEFAULT_FRAMES);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-variance") == 0) {
+        int frames = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_FRAMES;
+        return run_variance_benchmark(frames > 0 ? frames : BENCH_DEFAULT_FRAMES);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        int frames = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_FRAMES;
+        int mode = ANALYSIS_SINE;
+        for (int a = 3; a < argc; ++a) {
+            for (int m = 0; m < ANALYSIS_MODE_COUNT; ++m) {
+                if (strcmp(argv[a], analysis_mode_names[m]) == 0) {
+                    mode = m;
+                }
+            }
+            for (int m = 0; m < SPECTRUM_MODE_COUNT; ++m) {
+                if (strcmp(argv[a], spectral_mode_names[m]) == 0) {
+                    spectral_mode = m;
+                }
+            }
+            for (int m = 0; m < DETECTOR_MODE_COUNT; ++m) {
+                if (strcmp(argv[a], detector_mode_names[m]) == 0) {
+                    detector_mode = m;
+                }
+            }
+            for (int m = 0; m < WINDOW_COUNT; ++m) {
+                if (strcmp(argv[a], window_names[m]) == 0) {
+                    window_type = m;
+                }
+            }
+            int factor;
+            if (sscanf(argv[a], "pad%d", &factor) == 1) {
+                zero_pad = factor;
+            }
+            if (sscanf(argv[a], "overlap%d", &factor) == 1) {
+                frame_overlap = factor;
+            }
+            if (strcmp(argv[a], "fixed") == 0) {
+                fixed_point = true;
+            }
+            if (strcmp(argv[a], "agc") == 0) {
+                agc_enabled = true;
+            }
+            if (strcmp(argv[a], "tracked") == 0) {
+                tracked_search = true;
+            }
+            if (strcmp(argv[a], "demod") == 0) {
+                demod_enabled = true;
+            }
+            for (int m = 0; m < INTEGRATION_MODE_COUNT; ++m) {
+                if (strcmp(argv[a], integration_mode_names[m]) == 0) {
+                    integration_mode = m;
+                }
+            }
+        }
+        return run_benchmark(frames > 0 ? frames : BENCH_DEFAULT_FRAMES, mode);
+    }
+
     // --- 1. Initialization ---
     // Suppress less important SDL log messages such as unrecognized key warnings
     SDL_LogSetOutputFunction(sdl_log_filter, NULL);
@@ -151,21 +845,11 @@ int main(int argc, char* argv[]) {
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Successfully initialized graphical interface.");
 
     // --- 4. FFT Setup ---
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Setting up FFTW3...");
-    out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (FFT_SIZE / 2 + 1));
-    if (!out) {
-        log_error("FFTW memory allocation failed for output.");
+    if (!setup_fft()) {
         cleanup();
         return 1;
     }
-    p = fftw_plan_dft_r2c_1d(FFT_SIZE, pcm_buffer, out, FFTW_ESTIMATE);
-    freq_resolution = (double)SAMPLE_RATE / (double)FFT_SIZE;
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Frequency resolution: %.2f Hz", freq_resolution);
 
-    for (int i = 0; i < FFT_SIZE; ++i) {
-        hann_window[i] = 0.5 * (1.0 - cos((2.0 * M_PI * i) / (FFT_SIZE - 1)));
-    }
-    
     // --- 5. Audio Device Setup ---
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Opening audio device...");
     SDL_AudioSpec want, have;
@@ -203,26 +887,47 @@ int main(int argc, char* argv[]) {
                         persistence_threshold_ms -= 50;
                     }
                 } else if (event.key.keysym.sym == SDLK_RIGHT) {
-                    input_gain_db += 1.0;
+                    if (agc_enabled) {
+                        agc_target_db = fmin(agc_target_db + 1.0, AGC_CEILING_DB);
+                    } else {
+                        input_gain_db += 1.0;
+                    }
                 } else if (event.key.keysym.sym == SDLK_LEFT) {
-                    input_gain_db -= 1.0;
+                    if (agc_enabled) {
+                        agc_target_db -= 1.0;
+                    } else {
+                        input_gain_db -= 1.0;
+                    }
+                } else if (event.key.keysym.sym == SDLK_l) {
+                    SDL_LockAudioDevice(deviceId);
+                    agc_enabled = !agc_enabled;
+                    agc_gain_db = input_gain_db; // Start from the manual gain
+                    SDL_UnlockAudioDevice(deviceId);
+                    char log_text[128];
+                    sprintf(log_text, "Automatic gain control %s", agc_enabled ? "ON" : "OFF");
+                    Uint32 expire = SDL_GetTicks() + 2000;
+                    add_log_line(log_text, (SDL_Color){0, 255, 255, 255}, expire, -1);
                 } else if (event.key.keysym.sym == SDLK_z) {
                     if (bandpass_low_hz > SINE_WAVE_MIN_HZ) {
                         bandpass_low_hz -= 10.0;
                         if (bandpass_low_hz < SINE_WAVE_MIN_HZ) bandpass_low_hz = SINE_WAVE_MIN_HZ;
+                        update_bandpass();
                     }
                 } else if (event.key.keysym.sym == SDLK_x) {
                     if (bandpass_low_hz < bandpass_high_hz - 10.0) {
                         bandpass_low_hz += 10.0;
+                        update_bandpass();
                     }
                 } else if (event.key.keysym.sym == SDLK_c) {
                     if (bandpass_high_hz > bandpass_low_hz + 10.0) {
                         bandpass_high_hz -= 10.0;
+                        update_bandpass();
                     }
                 } else if (event.key.keysym.sym == SDLK_v) {
                     if (bandpass_high_hz < SINE_WAVE_MAX_HZ) {
                         bandpass_high_hz += 10.0;
                         if (bandpass_high_hz > SINE_WAVE_MAX_HZ) bandpass_high_hz = SINE_WAVE_MAX_HZ;
+                        update_bandpass();
                     }
                 } else if (event.key.keysym.sym == SDLK_a) {
                     averaging_enabled = !averaging_enabled;
@@ -246,29 +951,180 @@ int main(int argc, char* argv[]) {
                         squelch_threshold += 0.01;
                         if (squelch_threshold > 1.0) squelch_threshold = 1.0;
                     }
+                } else if (event.key.keysym.sym == SDLK_g) {
+                    if (silence_gate_db > SILENCE_GATE_MIN_DB) {
+                        silence_gate_db -= 5.0;
+                        if (silence_gate_db < SILENCE_GATE_MIN_DB) silence_gate_db = SILENCE_GATE_MIN_DB;
+                    }
+                } else if (event.key.keysym.sym == SDLK_h) {
+                    if (silence_gate_db < 0.0) {
+                        silence_gate_db += 5.0;
+                        if (silence_gate_db > 0.0) silence_gate_db = 0.0;
+                    }
+                } else if (event.key.keysym.sym == SDLK_w) {
+                    SDL_LockAudioDevice(deviceId);
+                    set_spectral_mode((spectral_mode + 1) % SPECTRUM_MODE_COUNT);
+                    SDL_UnlockAudioDevice(deviceId);
+                    char log_text[128];
+                    sprintf(log_text, "Spectrum estimator: %s", spectral_mode_names[spectral_mode]);
+                    Uint32 expire = SDL_GetTicks() + 2000;
+                    add_log_line(log_text, (SDL_Color){0, 255, 255, 255}, expire, -1);
+                } else if (event.key.keysym.sym == SDLK_n) {
+                    SDL_LockAudioDevice(deviceId);
+                    set_window((window_type + 1) % WINDOW_COUNT);
+                    SDL_UnlockAudioDevice(deviceId);
+                    char log_text[128];
+                    sprintf(log_text, "Periodogram window: %s", window_names[window_type]);
+                    Uint32 expire = SDL_GetTicks() + 2000;
+                    add_log_line(log_text, (SDL_Color){0, 255, 255, 255}, expire, -1);
+                } else if (event.key.keysym.sym == SDLK_p) {
+                    SDL_LockAudioDevice(deviceId);
+                    zero_pad = zero_pad >= ZERO_PAD_MAX ? 1 : zero_pad * 2;
+                    SDL_UnlockAudioDevice(deviceId);
+                    char log_text[128];
+                    sprintf(log_text, "Zero padding: %dx", zero_pad);
+                    Uint32 expire = SDL_GetTicks() + 2000;
+                    add_log_line(log_text, (SDL_Color){0, 255, 255, 255}, expire, -1);
+                } else if (event.key.keysym.sym == SDLK_o) {
+                    SDL_LockAudioDevice(deviceId);
+                    frame_overlap = frame_overlap >= FRAME_OVERLAP_MAX ? 1 : frame_overlap * 2;
+                    configure_decimation(decimation_stages);
+                    SDL_UnlockAudioDevice(deviceId);
+                    char log_text[128];
+                    sprintf(log_text, "Frame overlap: %dx", frame_overlap);
+                    Uint32 expire = SDL_GetTicks() + 2000;
+                    add_log_line(log_text, (SDL_Color){0, 255, 255, 255}, expire, -1);
+                } else if (event.key.keysym.sym == SDLK_i) {
+                    SDL_LockAudioDevice(deviceId);
+                    fixed_point = !fixed_point;
+                    configure_decimation(decimation_stages);
+                    SDL_UnlockAudioDevice(deviceId);
+                    char log_text[128];
+                    sprintf(log_text, "Fixed-point path %s", fixed_point ? "ON" : "OFF");
+                    Uint32 expire = SDL_GetTicks() + 2000;
+                    add_log_line(log_text, (SDL_Color){0, 255, 255, 255}, expire, -1);
+                } else if (event.key.keysym.sym == SDLK_e) {
+                    SDL_LockAudioDevice(deviceId);
+                    integration_mode = (integration_mode + 1) % INTEGRATION_MODE_COUNT;
+                    reset_integration();
+                    SDL_UnlockAudioDevice(deviceId);
+                    char log_text[128];
+                    sprintf(log_text, "Integration: %s", integration_mode_names[integration_mode]);
+                    Uint32 expire = SDL_GetTicks() + 2000;
+                    add_log_line(log_text, (SDL_Color){0, 255, 255, 255}, expire, -1);
+                } else if (event.key.keysym.sym == SDLK_k) {
+                    SDL_LockAudioDevice(deviceId);
+                    tracked_search = !tracked_search;
+                    frames_since_scan = 0;
+                    scan_power = 0.0; // Start with an acquisition scan
+                    SDL_UnlockAudioDevice(deviceId);
+                    char log_text[128];
+                    sprintf(log_text, "Tracked search: %s", tracked_search ? "ON" : "OFF");
+                    Uint32 expire = SDL_GetTicks() + 2000;
+                    add_log_line(log_text, (SDL_Color){0, 255, 255, 255}, expire, -1);
+                } else if (event.key.keysym.sym == SDLK_q) {
+                    SDL_LockAudioDevice(deviceId);
+                    demod_enabled = !demod_enabled;
+                    SDL_UnlockAudioDevice(deviceId);
+                    char log_text[128];
+                    sprintf(log_text, "Track demodulators: %s", demod_enabled ? "ON" : "OFF");
+                    Uint32 expire = SDL_GetTicks() + 2000;
+                    add_log_line(log_text, (SDL_Color){0, 255, 255, 255}, expire, -1);
+                } else if (event.key.keysym.sym == SDLK_m) {
+                    SDL_LockAudioDevice(deviceId);
+                    analysis_mode = (analysis_mode + 1) % ANALYSIS_MODE_COUNT;
+                    memset(&dtmf, 0, sizeof(dtmf));
+                    memset(&counter, 0, sizeof(counter));
+                    memset(&tracks, 0, sizeof(tracks));
+                    configure_decimation(decimation_stages); // Restores the frame timing
+                    SDL_UnlockAudioDevice(deviceId);
+                    char log_text[128];
+                    sprintf(log_text, "Analysis mode: %s", analysis_mode_names[analysis_mode]);
+                    Uint32 expire = SDL_GetTicks() + 2000;
+                    add_log_line(log_text, (SDL_Color){0, 255, 255, 255}, expire, -1);
+                } else if (event.key.keysym.sym == SDLK_t) {
+                    SDL_LockAudioDevice(deviceId);
+                    detector_mode = (detector_mode + 1) % DETECTOR_MODE_COUNT;
+                    SDL_UnlockAudioDevice(deviceId);
+                    char log_text[128];
+                    sprintf(log_text, "Peak detector: %s", detector_mode_names[detector_mode]);
+                    Uint32 expire = SDL_GetTicks() + 2000;
+                    add_log_line(log_text, (SDL_Color){0, 255, 255, 255}, expire, -1);
                 }
             }
         }
 
-        SineTrack snapshot[MAX_TRACKED_SINES];
+        SineTracks snapshot;
+        bool demod_ready[MAX_TRACKED_SINES];
+        bool demod_crowded[MAX_TRACKED_SINES];
+        double fm_rms_hz[MAX_TRACKED_SINES];
+        int dropouts[MAX_TRACKED_SINES];
+        double dropout_ms[MAX_TRACKED_SINES];
+        char digits[DTMF_MAX_PENDING];
+        int digit_count;
         SDL_LockAudioDevice(deviceId);
-        memcpy(snapshot, tracks, sizeof(tracks));
+        snapshot = tracks;
+        for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+            demod_ready[i] = tracks.active[i] && demods[i].start_time == tracks.start_time[i] && demods[i].count > 0;
+            demod_crowded[i] = tracks.active[i] && demods[i].start_time == tracks.start_time[i] && demods[i].crowded;
+            fm_rms_hz[i] = demods[i].fm_rms_hz;
+            dropouts[i] = demods[i].dropouts;
+            dropout_ms[i] = demods[i].last_dropout_ms;
+        }
+        digit_count = dtmf_pending_count;
+        memcpy(digits, dtmf_pending, digit_count);
+        dtmf_pending_count = 0;
         SDL_UnlockAudioDevice(deviceId);
 
+        // Log decoded DTMF digits and keep a short history for display
+        static char dtmf_history[DTMF_HISTORY + 1] = "";
+        for (int i = 0; i < digit_count; ++i) {
+            size_t len = strlen(dtmf_history);
+            if (len == DTMF_HISTORY) {
+                memmove(dtmf_history, dtmf_history + 1, len);
+                len--;
+            }
+            dtmf_history[len] = digits[i];
+            dtmf_history[len + 1] = '\0';
+            char log_text[128];
+            sprintf(log_text, "DTMF digit %c", digits[i]);
+            add_log_line(log_text, (SDL_Color){0, 255, 0, 255}, SDL_GetTicks() + 10000, -1);
+        }
+
         static bool prev_active[MAX_TRACKED_SINES] = {false};
         static double prev_freq[MAX_TRACKED_SINES] = {0.0};
+        static double prev_peak_db[MAX_TRACKED_SINES] = {0.0};
+        static int prev_dropouts[MAX_TRACKED_SINES] = {0};
         for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
-            if (snapshot[i].active) {
-                if (!prev_active[i] || fabs(snapshot[i].freq - prev_freq[i]) > FREQUENCY_TOLERANCE) {
+            if (snapshot.active[i]) {
+                if (!prev_active[i]) {
+                    prev_dropouts[i] = 0;
+                }
+                if (demod_ready[i] && dropouts[i] > prev_dropouts[i]) {
                     char log_text[128];
-                    sprintf(log_text, "Detected %.2f Hz (%.2f%% purity)", snapshot[i].freq, snapshot[i].purity);
+                    sprintf(log_text, "Dropout on %.2f Hz (%.0f ms)", snapshot.freq[i], dropout_ms[i]);
+                    add_log_line(log_text, (SDL_Color){255, 255, 0, 255}, SDL_GetTicks() + 3000, -1);
+                    prev_dropouts[i] = dropouts[i];
+                }
+                // A sweeping tone moves every frame; only log it when it first appears
+                bool sweeping = fabs(snapshot.rate[i]) >= SWEEP_MIN_RATE;
+                if (!prev_active[i] || (!sweeping && fabs(snapshot.freq[i] - prev_freq[i]) > FREQUENCY_TOLERANCE)) {
+                    char log_text[160];
+                    int len = sprintf(log_text, "Detected %.2f Hz (%.2f%% purity, %.1f dBFS, SNR %.1f dB", snapshot.freq[i],
+                                      snapshot.purity[i], snapshot.level_db[i], snapshot.snr_db[i]);
+                    if (snapshot.harmonics[i] > 0) {
+                        sprintf(log_text + len, ", %d harmonics)", snapshot.harmonics[i]);
+                    } else {
+                        sprintf(log_text + len, ")");
+                    }
                     add_log_line(log_text, (SDL_Color){0, 255, 0, 255}, 0, i);
                 }
                 prev_active[i] = true;
-                prev_freq[i] = snapshot[i].freq;
+                prev_freq[i] = snapshot.freq[i];
+                prev_peak_db[i] = snapshot.peak_db[i];
             } else if (prev_active[i]) {
                 char log_text[128];
-                sprintf(log_text, "Lost %.2f Hz", prev_freq[i]);
+                sprintf(log_text, "Lost %.2f Hz (peak %.1f dBFS)", prev_freq[i], prev_peak_db[i]);
                 Uint32 expire = SDL_GetTicks() + 3000;
                 add_log_line(log_text, (SDL_Color){255, 255, 0, 255}, expire, i);
                 for (int j = log_count - 1; j >= 0; --j) {
@@ -287,40 +1143,152 @@ int main(int argc, char* argv[]) {
 
         // Render status text and controls
         SDL_Color color_white = {255, 255, 255, 255};
-        render_text("ESC: exit", 100, 80, color_white);
-        render_text("UP/DOWN: adjust persistence", 100, 100, color_white);
-        render_text("LEFT/RIGHT: adjust gain", 100, 120, color_white);
-        render_text("Z/X: low cutoff  C/V: high cutoff", 100, 140, color_white);
-        render_text("A: toggle averaging", 100, 160, color_white);
-        render_text("S/D/F: squelch toggle/adjust", 100, 180, color_white);
+        static const char* help_lines[] = {
+            "ESC: exit",
+            "UP/DOWN: adjust persistence",
+            "LEFT/RIGHT: adjust gain (AGC target)  L: automatic gain control",
+            "Z/X: low cutoff  C/V: high cutoff",
+            "A: toggle averaging",
+            "W: cycle spectrum estimator  N: cycle window  P: zero padding",
+            "O: cycle frame overlap  I: fixed-point path  E: cycle integration",
+            "S/D/F: squelch toggle/adjust",
+            "G/H: silence gate floor",
+            "M: cycle analysis mode",
+            "T: cycle peak detector",
+        };
+        int text_y = 80;
+        for (size_t i = 0; i < sizeof(help_lines) / sizeof(help_lines[0]); ++i) {
+            render_text(help_lines[i], 100, text_y, color_white);
+            text_y += 20;
+        }
         char persist_text[80];
         sprintf(persist_text, "Persistence: %d ms", persistence_threshold_ms);
-        render_text(persist_text, 100, 200, color_white);
-        char gain_text[80];
-        sprintf(gain_text, "Gain: %.1f dB", input_gain_db);
-        render_text(gain_text, 100, 220, color_white);
+        render_text(persist_text, 100, text_y, color_white);
+        text_y += 20;
+        char gain_text[160];
+        SDL_LockAudioDevice(deviceId);
+        double gain_db = frame_gain_db;
+        Uint64 clips = clipped_samples;
+        bool clipping = clips > 0 && SDL_GetTicks() - last_clip_time < 1000;
+        SDL_UnlockAudioDevice(deviceId);
+        int gain_len;
+        if (agc_enabled) {
+            gain_len = sprintf(gain_text, "Gain: AGC %.1f dB (target %.0f dBFS, attack %.0f ms, release %.0f ms)", gain_db,
+                               agc_target_db, agc_attack_ms, agc_release_ms);
+        } else {
+            gain_len = sprintf(gain_text, "Gain: %.1f dB", input_gain_db);
+        }
+        sprintf(gain_text + gain_len, " | %s (%llu samples clipped)", clipping ? "CLIPPING" : "no clipping",
+                (unsigned long long)clips);
+        render_text(gain_text, 100, text_y, clipping ? (SDL_Color){255, 80, 80, 255} : color_white);
+        text_y += 20;
         char band_text[120];
-        sprintf(band_text, "Band-pass: %.0f-%.0f Hz", bandpass_low_hz, bandpass_high_hz);
-        render_text(band_text, 100, 240, color_white);
+        sprintf(band_text, "Band-pass: %.0f-%.0f Hz (analysis at %d Hz, %.2f Hz bins)", bandpass_low_hz, bandpass_high_hz,
+                SAMPLE_RATE >> decimation_stages, freq_resolution);
+        render_text(band_text, 100, text_y, color_white);
+        text_y += 20;
+        char gate_text[160];
+        SDL_LockAudioDevice(deviceId);
+        double skipped = gate_chunks > 0 ? 100.0 * gate_skipped / gate_chunks : 0.0;
+        int gate_len = sprintf(gate_text, "Input: %.1f dBFS peak, %.1f dBFS RMS | ", input_peak_db, input_rms_db);
+        SDL_UnlockAudioDevice(deviceId);
+        if (silence_gate_db > SILENCE_GATE_MIN_DB) {
+            sprintf(gate_text + gate_len, "Silence gate: %.0f dBFS (%.1f%% of chunks skipped)", silence_gate_db, skipped);
+        } else {
+            sprintf(gate_text + gate_len, "Silence gate: OFF");
+        }
+        render_text(gate_text, 100, text_y, color_white);
+        text_y += 20;
+        char overlap_text[120];
+        sprintf(overlap_text, "Frame overlap: %dx (a frame every %.1f ms)", frame_overlap, frame_seconds * 1000.0);
+        render_text(overlap_text, 100, text_y, color_white);
+        text_y += 20;
+        char integration_text[160];
+        if (integration_mode == INTEGRATION_OFF) {
+            sprintf(integration_text, "Integration: OFF");
+        } else {
+            bool phase = !fixed_path_active() && taper_banks[spectral_mode].count == 0;
+            sprintf(integration_text, "Integration: %s over %d frames (detection every %.0f ms, incoherent threshold %.1f dB)%s",
+                    integration_mode_names[integration_mode], INTEGRATION_FRAMES, detection_seconds() * 1000.0,
+                    10.0 * log10(integration_snr),
+                    integration_mode == INTEGRATION_COHERENT && !phase ? ", estimator has no phase" : "");
+        }
+        render_text(integration_text, 100, text_y, color_white);
+        text_y += 20;
+        char search_text[120];
+        if (tracked_search) {
+            sprintf(search_text, "Tracked search: ON (full scan every %d frames or on a %.0f dB power change)%s",
+                    ACQUISITION_INTERVAL, ACQUISITION_ENERGY_DB,
+                    integration_mode != INTEGRATION_OFF ? ", suspended during integration" : "");
+        } else {
+            sprintf(search_text, "Tracked search: OFF");
+        }
+        render_text(search_text, 100, text_y, color_white);
+        text_y += 20;
+        char demod_text[120];
+        if (demod_enabled) {
+            sprintf(demod_text, "Track demodulators: ON (%d Hz complex stream per track)", SAMPLE_RATE / DEMOD_DECIMATION);
+        } else {
+            sprintf(demod_text, "Track demodulators: OFF");
+        }
+        render_text(demod_text, 100, text_y, color_white);
+        text_y += 20;
         char avg_text[80];
         sprintf(avg_text, "Averaging: %s", averaging_enabled ? "ON" : "OFF");
-        render_text(avg_text, 100, 260, color_white);
+        render_text(avg_text, 100, text_y, color_white);
+        text_y += 20;
+        char spectrum_text[120];
+        sprintf(spectrum_text, "Spectrum estimator: %s%s", spectral_mode_names[spectral_mode],
+                !fixed_point ? "" : fixed_path_active() ? " (fixed-point)" : " (fixed-point needs periodogram)");
+        render_text(spectrum_text, 100, text_y, color_white);
+        text_y += 20;
+        char window_text[120];
+        sprintf(window_text, "Window: %s (coherent gain %.3f, ENBW %.2f bins), zero padding %dx", window_names[window_type],
+                window_info[window_type].coherent_gain, window_info[window_type].enbw, zero_pad);
+        render_text(window_text, 100, text_y, color_white);
+        text_y += 20;
         char squelch_text[80];
         sprintf(squelch_text, "Squelch: %s (%.0f%%)", squelch_enabled ? "ON" : "OFF", squelch_threshold * 100.0);
-        render_text(squelch_text, 100, 280, color_white);
+        render_text(squelch_text, 100, text_y, color_white);
+        text_y += 20;
+        char mode_text[80];
+        sprintf(mode_text, "Analysis mode: %s", analysis_mode_names[analysis_mode]);
+        render_text(mode_text, 100, text_y, color_white);
+        text_y += 20;
+        char detector_text[80];
+        sprintf(detector_text, "Peak detector: %s", detector_mode_names[detector_mode]);
+        render_text(detector_text, 100, text_y, color_white);
+        text_y += 20;
         // Render detection result
-        int line_y = 300;
+        int line_y = text_y;
+        int log_y = text_y + (MAX_TRACKED_SINES + 1) * LINE_SPACING + 4;
+        if (analysis_mode == ANALYSIS_DTMF) {
+            char dtmf_text[80];
+            sprintf(dtmf_text, "DTMF: %s", dtmf_history[0] ? dtmf_history : "(listening)");
+            render_text(dtmf_text, 100, line_y, (SDL_Color){0, 255, 0, 255});
+            line_y += LINE_SPACING;
+        }
         int active_count = 0;
         for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
-            if (snapshot[i].active) {
-                char output_text[100];
-                sprintf(output_text, "Sine wave detected! Freq: %.2f Hz | Purity: %.2f%%", snapshot[i].freq, snapshot[i].purity);
+            if (snapshot.active[i]) {
+                char output_text[256];
+                int len = sprintf(output_text, "Sine wave detected! Freq: %.2f Hz | Purity: %.2f%% | Level: %.1f dBFS (peak %.1f) | SNR: %.1f dB | Harmonics: %d",
+                                  snapshot.freq[i], snapshot.purity[i], snapshot.level_db[i], snapshot.peak_db[i],
+                                  snapshot.snr_db[i], snapshot.harmonics[i]);
+                if (fabs(snapshot.rate[i]) >= SWEEP_MIN_RATE) {
+                    len += sprintf(output_text + len, " | Sweep: %+.0f Hz/s", snapshot.rate[i]);
+                }
+                if (demod_ready[i]) {
+                    sprintf(output_text + len, " | FM: %.1f Hz rms | Dropouts: %d", fm_rms_hz[i], dropouts[i]);
+                } else if (demod_crowded[i]) {
+                    sprintf(output_text + len, " | FM: crowded");
+                }
                 render_text(output_text, 100, line_y, (SDL_Color){0, 255, 0, 255});
                 line_y += LINE_SPACING;
                 active_count++;
             }
         }
-        if (active_count == 0) {
+        if (active_count == 0 && analysis_mode != ANALYSIS_DTMF) {
             render_text("No pure sine wave detected. Listening...", 100, line_y, (SDL_Color){255, 255, 0, 255});
             line_y += LINE_SPACING;
         }
@@ -328,7 +1296,7 @@ int main(int argc, char* argv[]) {
         // Render log lines
         prune_expired_logs(SDL_GetTicks());
         for (int i = 0; i < log_count; ++i) {
-            render_text(log_entries[i].text, 100, 400 + i * LINE_SPACING, log_entries[i].color);
+            render_text(log_entries[i].text, 100, log_y + i * LINE_SPACING, log_entries[i].color);
         }
 
         // --- Render frequency spectrum visualization ---
@@ -341,18 +1309,29 @@ int main(int argc, char* argv[]) {
         SDL_SetRenderDrawColor(renderer, 30, 30, 30, 255);
         SDL_RenderFillRect(renderer, &vis_bg);
 
-        // Draw frequency line graph
+        // Draw frequency line graph. When there are more bins than pixel
+        // columns, each column shows the maximum of its bins, taken from a
+        // block-max pyramid, so narrow tones are never dropped between pixels.
         SDL_SetRenderDrawColor(renderer, 0, 128, 255, 255);
+        static double display_magnitudes[FFT_SIZE / 2];
+        static MaxPyramid display_pyramid;
         SDL_Point points[FFT_SIZE / 2];
         SDL_LockAudioDevice(deviceId); // Lock audio to safely access magnitudes
-        for (int i = 0; i < FFT_SIZE / 2; ++i) {
-            int x = VIS_PADDING + (int)((double)i / (FFT_SIZE / 2) * vis_width);
-            int bar_height = (int)(magnitudes[i] * VIS_HEIGHT);
-            points[i].x = x;
-            points[i].y = vis_y_end - bar_height;
-        }
+        memcpy(display_magnitudes, magnitudes, sizeof(magnitudes));
+        double spectrum_width = FFT_SIZE / 2 * freq_resolution / (SAMPLE_RATE / 2.0) * vis_width;
         SDL_UnlockAudioDevice(deviceId);
-        SDL_RenderDrawLines(renderer, points, FFT_SIZE / 2);
+        build_max_pyramid(&display_pyramid, display_magnitudes, FFT_SIZE / 2);
+        int columns = spectrum_width < FFT_SIZE / 2 ? (int)spectrum_width : FFT_SIZE / 2;
+        for (int c = 0; c < columns; ++c) {
+            int lo = (int)((Sint64)c * (FFT_SIZE / 2) / columns);
+            int hi = (int)((Sint64)(c + 1) * (FFT_SIZE / 2) / columns) - 1;
+            int bar_height = (int)(pyramid_max(&display_pyramid, lo, hi) * VIS_HEIGHT);
+            points[c].x = VIS_PADDING + (int)(lo * spectrum_width / (FFT_SIZE / 2));
+            points[c].y = vis_y_end - bar_height;
+        }
+        if (columns > 1) {
+            SDL_RenderDrawLines(renderer, points, columns);
+        }
 
         // Highlight band-pass region and block-color out-of-band areas
         SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
@@ -388,10 +1367,9 @@ int main(int argc, char* argv[]) {
 
         // Highlight detected frequencies
         for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
-            if (snapshot[i].active) {
-                int freq_bin = (int)(snapshot[i].freq / freq_resolution);
-                if (freq_bin >= 0 && freq_bin < FFT_SIZE / 2) {
-                    int x = VIS_PADDING + (int)((double)freq_bin / (FFT_SIZE / 2) * vis_width);
+            if (snapshot.active[i]) {
+                if (snapshot.freq[i] >= 0.0 && snapshot.freq[i] < SAMPLE_RATE / 2.0) {
+                    int x = VIS_PADDING + (int)(snapshot.freq[i] / (SAMPLE_RATE / 2.0) * vis_width);
                     SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Red highlight
                     SDL_RenderDrawLine(renderer, x, vis_y_start, x, vis_y_end);
                 }
@@ -412,162 +1390,3159 @@ int main(int argc, char* argv[]) {
     return 0;
 }
 
-void update_track(double freq, double purity, Uint32 now) {
-    int match = -1;
-    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
-        if (tracks[i].start_time != 0 && fabs(tracks[i].freq - freq) <= FREQUENCY_TOLERANCE) {
-            match = i;
-            break;
+bool setup_fft(void) {
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Setting up FFTW3...");
+    fft_threads_ready = fftw_init_threads() != 0;
+    if (!fft_threads_ready) {
+        log_error("FFTW thread support unavailable; large transforms run single-threaded.");
+    }
+    out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (FFT_SIZE / 2 + 1));
+    if (!out) {
+        log_error("FFTW memory allocation failed for output.");
+        return false;
+    }
+    p = fftw_plan_dft_r2c_1d(FFT_SIZE, pcm_buffer, out, FFTW_ESTIMATE);
+    setup_halfband();
+    configure_decimation(0);
+    design_bandpass(bandpass_low_hz, bandpass_high_hz, SAMPLE_RATE, &prefilter.c);
+    setup_cfar();
+    setup_integration();
+    setup_demod();
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Frequency resolution: %.2f Hz", freq_resolution);
+
+    if (!setup_windows()) {
+        return false;
+    }
+    setup_fixed_point();
+    dtmf_init();
+
+    // Welch: Hann segments at 50% overlap, zero outside their span
+    taper_banks[SPECTRUM_PERIODOGRAM].peak_halfwidth = window_info[window_type].halfwidth;
+    TaperBank* welch = &taper_banks[SPECTRUM_WELCH];
+    if (!setup_taper_bank(welch, WELCH_SEGMENTS)) {
+        return false;
+    }
+    for (int k = 0; k < WELCH_SEGMENTS; ++k) {
+        double* w = welch->window + k * FFT_SIZE;
+        int offset = k * WELCH_SEGMENT_SIZE / 2;
+        for (int i = 0; i < WELCH_SEGMENT_SIZE; ++i) {
+            w[offset + i] = 0.5 * (1.0 - cos((2.0 * M_PI * i) / (WELCH_SEGMENT_SIZE - 1)));
         }
     }
-    if (match == -1) {
-        for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
-            if (tracks[i].start_time == 0) {
-                match = i;
-                break;
+    welch->peak_halfwidth = FFT_SIZE / WELCH_SEGMENT_SIZE;
+
+    TaperBank* multitaper = &taper_banks[SPECTRUM_MULTITAPER];
+    if (!setup_taper_bank(multitaper, MULTITAPER_TAPERS)) {
+        return false;
+    }
+    if (!dpss_tapers(FFT_SIZE, MULTITAPER_NW, MULTITAPER_TAPERS, multitaper->window)) {
+        log_error("DPSS taper computation failed.");
+        return false;
+    }
+    multitaper->peak_halfwidth = (int)ceil(MULTITAPER_NW);
+
+    // A bin-centred sine of amplitude A peaks at (A/2 * sum(w))^2 through a
+    // taper w; match the average over the bank to the Hann (FFT_SIZE/4)^2
+    for (int m = SPECTRUM_WELCH; m < SPECTRUM_MODE_COUNT; ++m) {
+        TaperBank* bank = &taper_banks[m];
+        double mean_peak = 0.0;
+        double mean_energy = 0.0;
+        for (int k = 0; k < bank->count; ++k) {
+            double sum = 0.0;
+            double sum_sq = 0.0;
+            for (int i = 0; i < FFT_SIZE; ++i) {
+                double w = bank->window[k * FFT_SIZE + i];
+                sum += w;
+                sum_sq += w * w;
             }
+            mean_peak += (0.5 * sum) * (0.5 * sum) / bank->count;
+            mean_energy += 0.25 * sum_sq / bank->count;
         }
+        bank->scale = (FFT_SIZE / 4.0) * (FFT_SIZE / 4.0) / mean_peak;
+        bank->enbw = FFT_SIZE * mean_energy / mean_peak;
     }
-    if (match != -1) {
-        if (tracks[match].start_time == 0) {
-            tracks[match].freq = freq;
-            tracks[match].purity = purity * 100.0;
-            tracks[match].start_time = now;
-            tracks[match].last_seen = now;
-            tracks[match].active = false;
-        } else {
-            tracks[match].freq = tracks[match].freq * 0.9 + freq * 0.1;
-            tracks[match].purity = purity * 100.0;
-            tracks[match].last_seen = now;
-        }
+    if (!setup_polyphase()) {
+        return false;
     }
+    if (!setup_zero_padding()) {
+        return false;
+    }
+    if (!setup_frame_batches()) {
+        return false;
+    }
+    if (!setup_lowband()) {
+        return false;
+    }
+    set_spectral_mode(spectral_mode);
+    return true;
 }
 
-// --- Audio Callback Function ---
-// This function is called by SDL whenever it has a new chunk of audio data
-void audio_callback(void* userdata, Uint8* stream, int len) {
-    Sint16* pcm_stream = (Sint16*)stream;
-    double gain = pow(10.0, input_gain_db / 20.0);
-    for (int i = 0; i < CHUNK_SIZE; ++i) {
-        pcm_buffer[i] = ((double)pcm_stream[i] / MAX_AMPLITUDE) * gain * hann_window[i];
+// Design the polyphase prototype: a sinc whose passband spans
+// POLYPHASE_CHANNEL_WIDTH channels, shaped by a Blackman window over
+// POLYPHASE_TAPS frames. A tone anywhere in a channel loses at most ~3.5 dB.
+// Leakage beyond the neighbouring channel is about -100 dB for a tone at a
+// channel centre; at worst, from a channel edge, it reaches -74 dB some 1.6
+// channels away.
+bool setup_polyphase(void) {
+    int length = POLYPHASE_TAPS * FFT_SIZE;
+    polyphase.prototype = (double*)malloc(sizeof(double) * length);
+    polyphase.history = (double*)calloc(length, sizeof(double));
+    if (!polyphase.prototype || !polyphase.history) {
+        log_error("Memory allocation failed for polyphase filter bank.");
+        return false;
     }
-    fftw_execute(p);
-
-    double total_power = 0.0;
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    for (int n = 0; n < length; ++n) {
+        double x = POLYPHASE_CHANNEL_WIDTH * (n - (length - 1) / 2.0) / FFT_SIZE;
+        double sinc = x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+        double phase = 2.0 * M_PI * n / (length - 1);
+        double window = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+        polyphase.prototype[n] = sinc * window;
+        sum += polyphase.prototype[n];
+        sum_sq += polyphase.prototype[n] * polyphase.prototype[n];
+    }
+    polyphase.newest = 0;
+    polyphase.scale = (FFT_SIZE / 4.0) * (FFT_SIZE / 4.0) / ((0.5 * sum) * (0.5 * sum));
+    // A tone's power summed over all channels against its channel-centre peak
+    polyphase.enbw = FFT_SIZE * sum_sq / (sum * sum);
+    taper_banks[SPECTRUM_POLYPHASE].peak_halfwidth = 1;
+    return true;
+}
 
-    double powers[FFT_SIZE / 2];
-    for (int i = 0; i < FFT_SIZE / 2; ++i) {
-        double real = out[i][0];
-        double imag = out[i][1];
-        double power = real * real + imag * imag;
-        double freq = i * freq_resolution;
-        if (freq < bandpass_low_hz || freq > bandpass_high_hz) {
-            power = 0.0; // Apply band-pass filter in frequency domain
-        }
-        if (averaging_enabled) {
-            avg_powers[i] = AVERAGING_ALPHA * power + (1.0 - AVERAGING_ALPHA) * avg_powers[i];
-            power = avg_powers[i];
-        } else {
-            avg_powers[i] = power;
+// Push one frame into the ring and fold the last POLYPHASE_TAPS frames
+// through the prototype into pcm_buffer, ready for the regular FFT plan
+void polyphase_frame(const double* samples) {
+    polyphase.newest = (polyphase.newest + 1) % POLYPHASE_TAPS;
+    double* slot = polyphase.history + polyphase.newest * FFT_SIZE;
+    memcpy(slot, samples, sizeof(double) * FFT_SIZE);
+    memset(pcm_buffer, 0, sizeof(pcm_buffer));
+    for (int t = 0; t < POLYPHASE_TAPS; ++t) {
+        // Tap t (oldest first) weights the frame t slots after the newest
+        const double* frame = polyphase.history + ((polyphase.newest + 1 + t) % POLYPHASE_TAPS) * FFT_SIZE;
+        const double* h = polyphase.prototype + t * FFT_SIZE;
+        for (int i = 0; i < FFT_SIZE; ++i) {
+            pcm_buffer[i] += frame[i] * h[i];
         }
-        powers[i] = power;
     }
+}
 
-    /*
-     * Normalize spectrum magnitudes against the theoretical maximum power of a
-     * full-scale sine wave so that input gain changes are reflected in the
-     * visualization. Previously the magnitudes were normalised by the maximum
-     * power of the current frame, which hid overall amplitude variations.
-     *
-     * For a Hann-windowed, full-scale sine wave the peak power is roughly
-     * (FFT_SIZE/4)^2.  Scaling by this constant keeps magnitudes in the
-     * 0.0-1.0 range while allowing gain adjustments to impact the display.
-     */
-    double max_possible_power = (FFT_SIZE / 4.0) * (FFT_SIZE / 4.0);
-    total_power = 0.0;
-    for (int i = 0; i < FFT_SIZE / 2; ++i) {
-        double norm = powers[i] / max_possible_power;
-        if (norm > 1.0) {
-            norm = 1.0;
-        }
-        if (squelch_enabled && norm < squelch_threshold) {
-            powers[i] = 0.0;
-            norm = 0.0;
-        }
-        magnitudes[i] = norm;
-        total_power += powers[i];
+// Allocate a bank of count tapers and plan one batched real FFT over them
+bool setup_taper_bank(TaperBank* bank, int count) {
+    bank->count = count;
+    bank->window = (double*)calloc((size_t)count * FFT_SIZE, sizeof(double));
+    bank->in = (double*)fftw_malloc(sizeof(double) * count * FFT_SIZE);
+    bank->out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * count * (FFT_SIZE / 2 + 1));
+    if (!bank->window || !bank->in || !bank->out) {
+        log_error("FFTW memory allocation failed for taper bank.");
+        return false;
     }
+    int n = FFT_SIZE;
+    bank->plan = fftw_plan_many_dft_r2c(1, &n, count,
+                                        bank->in, NULL, 1, FFT_SIZE,
+                                        bank->out, NULL, 1, FFT_SIZE / 2 + 1,
+                                        FFTW_ESTIMATE);
+    if (!bank->plan) {
+        log_error("FFTW batched plan creation failed.");
+        return false;
+    }
+    return true;
+}
 
-    // Find top peaks while merging nearby bins to avoid duplicate detections
-    int top_indices[MAX_TRACKED_SINES];
-    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
-        top_indices[i] = -1;
+// Number of eigenvalues of the DPSS tridiagonal matrix below x (Sturm count)
+static int dpss_sturm_count(int n, const double* diag, const double* off, double x) {
+    int count = 0;
+    double q = diag[0] - x;
+    if (q < 0.0) count++;
+    for (int i = 1; i < n; ++i) {
+        if (q == 0.0) q = 1e-300;
+        q = (diag[i] - x) - off[i] * off[i] / q;
+        if (q < 0.0) count++;
     }
+    return count;
+}
 
-    bool used[FFT_SIZE / 2] = {false};
-    for (int p = 0; p < MAX_TRACKED_SINES; ++p) {
-        int best = -1;
-        double best_power = 0.0;
-        for (int i = 1; i < FFT_SIZE / 2 - 1; ++i) {
-            if (used[i]) continue;
-            double power = powers[i];
-            if (power > best_power && power > powers[i - 1] && power >= powers[i + 1]) {
-                best_power = power;
-                best = i;
-            }
-        }
-        if (best == -1) {
-            break;
-        }
-        top_indices[p] = best;
-        for (int k = best - PEAK_SUPPRESS_BINS; k <= best + PEAK_SUPPRESS_BINS; ++k) {
-            if (k >= 0 && k < FFT_SIZE / 2) {
-                used[k] = true;
+// Compute the first count discrete prolate spheroidal sequences of length n
+// as the eigenvectors of the largest eigenvalues of the symmetric tridiagonal
+// matrix that commutes with the concentration problem. Eigenvalues come from
+// Sturm-sequence bisection and eigenvectors from inverse iteration, so the
+// whole computation is O(n) per taper. Tapers are normalised to unit energy.
+bool dpss_tapers(int n, double nw, int count, double* tapers) {
+    double* diag = (double*)malloc(sizeof(double) * n);
+    double* off = (double*)malloc(sizeof(double) * n);
+    double* c = (double*)malloc(sizeof(double) * n);
+    double* x = (double*)malloc(sizeof(double) * n);
+    if (!diag || !off || !c || !x) {
+        free(diag);
+        free(off);
+        free(c);
+        free(x);
+        return false;
+    }
+    double cos_w = cos(2.0 * M_PI * nw / n);
+    double lo = 0.0, hi = 0.0;
+    for (int i = 0; i < n; ++i) {
+        double t = 0.5 * (n - 1 - 2 * i);
+        diag[i] = t * t * cos_w;
+        off[i] = i > 0 ? 0.5 * i * (n - i) : 0.0;
+    }
+    for (int i = 0; i < n; ++i) {
+        double radius = off[i] + (i + 1 < n ? off[i + 1] : 0.0);
+        if (i == 0 || diag[i] - radius < lo) lo = diag[i] - radius;
+        if (i == 0 || diag[i] + radius > hi) hi = diag[i] + radius;
+    }
+
+    for (int k = 0; k < count; ++k) {
+        // The k-th largest eigenvalue has n-1-k eigenvalues below it
+        double a = lo, b = hi;
+        for (int iter = 0; iter < 200 && b - a > 1e-12 * fmax(fabs(a), fabs(b)); ++iter) {
+            double mid = 0.5 * (a + b);
+            if (dpss_sturm_count(n, diag, off, mid) <= n - 1 - k) {
+                a = mid;
+            } else {
+                b = mid;
             }
         }
-    }
+        double lambda = 0.5 * (a + b);
 
-    Uint32 now = SDL_GetTicks();
-    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
-        int idx = top_indices[i];
-        if (idx == -1 || total_power == 0.0) {
-            continue;
+        double* v = tapers + (size_t)k * n;
+        for (int i = 0; i < n; ++i) {
+            v[i] = 1.0 + 0.001 * i; // Not orthogonal to odd or even sequences
         }
-        double freq = idx * freq_resolution;
-        double peak_power = 0.0;
-        for (int j = -1; j <= 1; ++j) {
-            int n = idx + j;
-            if (n >= 0 && n < FFT_SIZE / 2) {
-                peak_power += powers[n];
+        for (int iter = 0; iter < 3; ++iter) {
+            // Solve (T - lambda I) x = v with the Thomas algorithm
+            double pivot = diag[0] - lambda;
+            if (pivot == 0.0) pivot = 1e-300;
+            c[0] = off[1] / pivot;
+            x[0] = v[0] / pivot;
+            for (int i = 1; i < n; ++i) {
+                pivot = (diag[i] - lambda) - off[i] * c[i - 1];
+                if (pivot == 0.0) pivot = 1e-300;
+                c[i] = i + 1 < n ? off[i + 1] / pivot : 0.0;
+                x[i] = (v[i] - off[i] * x[i - 1]) / pivot;
+            }
+            for (int i = n - 2; i >= 0; --i) {
+                x[i] -= c[i] * x[i + 1];
             }
+            // Orthogonalise against earlier tapers and normalise
+            for (int j = 0; j < k; ++j) {
+                const double* u = tapers + (size_t)j * n;
+                double dot = 0.0;
+                for (int i = 0; i < n; ++i) dot += u[i] * x[i];
+                for (int i = 0; i < n; ++i) x[i] -= dot * u[i];
+            }
+            double norm = 0.0;
+            for (int i = 0; i < n; ++i) norm += x[i] * x[i];
+            norm = sqrt(norm);
+            for (int i = 0; i < n; ++i) v[i] = x[i] / norm;
         }
-        double purity = peak_power / total_power;
-        if (purity > DETECT_THRESHOLD &&
-            freq >= bandpass_low_hz &&
-            freq <= bandpass_high_hz) {
-            update_track(freq, purity, now);
+        // Conventional sign: positive mean for even tapers, positive first lobe for odd
+        double sign_ref = 0.0;
+        for (int i = 0; i < n; ++i) {
+            sign_ref += (k % 2 == 0) ? v[i] : v[i] * (n - 1 - 2 * i);
+        }
+        if (sign_ref < 0.0) {
+            for (int i = 0; i < n; ++i) v[i] = -v[i];
         }
     }
+    free(diag);
+    free(off);
+    free(c);
+    free(x);
+    return true;
+}
 
-    // update track states
-    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
-        if (tracks[i].start_time != 0 && !tracks[i].active) {
-            if (now - tracks[i].start_time >= (Uint32)persistence_threshold_ms) {
-                tracks[i].active = true;
-                tracks[i].last_seen = now;
-            }
-        } else if (tracks[i].active) {
-            if (now - tracks[i].last_seen >= (Uint32)persistence_threshold_ms) {
-                tracks[i].active = false;
-                tracks[i].start_time = 0;
-            }
-        }
+// Threads for a transform of n points: one below the threshold, then one
+// per half-threshold of points up to the number of cores
+int fft_threads_for(int n) {
+    if (n < fft_threads_min_size) {
+        return 1;
     }
+    int threads = (int)(2LL * n / fft_threads_min_size);
+    int cores = SDL_GetCPUCount();
+    return threads < cores ? threads : (cores > 0 ? cores : 1);
 }
 
-// --- Helper Functions ---
-void add_log_line(const char* text, SDL_Color color, Uint32 expire_time, int track_id) {
-    SDL_LockAudioDevice(deviceId); // Prevent race condition with audio thread
+// Set the thread count FFTW uses for the plans created next
+void plan_threads_for(int n) {
+    if (fft_threads_ready) {
+        fftw_plan_with_nthreads(fft_threads_for(n));
+    }
+}
+
+// --- Fixed-Point Path ---
+// A window whose mean exceeds 1/2 (a Kaiser window with beta below about
+// 6) is scaled down to that mean, which the FFT's headroom relies on; the
+// power scale takes the factor back out
+void setup_fixed_point(void) {
+    for (int t = 0; t < WINDOW_COUNT; ++t) {
+        double mean = window_info[t].coherent_gain;
+        fixed_window_scale[t] = mean > 0.5 ? 0.5 / mean : 1.0;
+        for (int i = 0; i < FFT_SIZE; ++i) {
+            double w = fmin(fmax(window_tables[t][i], -1.0), 1.0) * fixed_window_scale[t];
+            fixed_windows[t][i] = (Sint16)lrint(w * Q15_ONE);
+        }
+    }
+    for (int k = 0; k < FFT_SIZE / 2; ++k) {
+        double phase = 2.0 * M_PI * k / FFT_SIZE;
+        fixed_twiddle[k][0] = (Sint32)lrint(cos(phase) * Q30_ONE);
+        fixed_twiddle[k][1] = (Sint32)lrint(-sin(phase) * Q30_ONE);
+    }
+    for (int n = 0; n < FIXED_FFT_POINTS; ++n) {
+        int r = 0;
+        for (int b = 0; b < FIXED_FFT_BITS; ++b) {
+            r |= ((n >> b) & 1) << (FIXED_FFT_BITS - 1 - b);
+        }
+        fixed_bitrev[n] = r;
+    }
+}
+
+// The integer path replaces the windowed periodogram only
+bool fixed_path_active(void) {
+    return fixed_point && spectral_mode == SPECTRUM_PERIODOGRAM;
+}
+
+// Q30 multiply with rounding; the product needs 64 bits
+static inline Sint32 q30_mul(Sint32 a, Sint32 b) {
+    return (Sint32)(((Sint64)a * b + (1 << 29)) >> 30);
+}
+
+// In-place decimation-in-time FFT over FIXED_FFT_POINTS bit-reversed
+// points. Nothing is scaled between stages: windowed input below 2^19
+// grows by at most the transform length, and setup_fixed_point keeps every
+// Q15 window's sum to at most half the frame, so even the split spectrum
+// stays below 2^30.
+void fixed_fft(Sint32* re, Sint32* im) {
+    for (int len = 2; len <= FIXED_FFT_POINTS; len <<= 1) {
+        int half = len / 2;
+        int step = FFT_SIZE / len; // W_len^j is W_FFT_SIZE^(j * step)
+        for (int i = 0; i < FIXED_FFT_POINTS; i += len) {
+            for (int j = 0; j < half; ++j) {
+                const Sint32* w = fixed_twiddle[j * step];
+                Sint32 ar = re[i + j + half], ai = im[i + j + half];
+                Sint32 vr = q30_mul(ar, w[0]) - q30_mul(ai, w[1]);
+                Sint32 vi = q30_mul(ar, w[1]) + q30_mul(ai, w[0]);
+                Sint32 ur = re[i + j], ui = im[i + j];
+                re[i + j] = ur + vr;
+                im[i + j] = ui + vi;
+                re[i + j + half] = ur - vr;
+                im[i + j + half] = ui - vi;
+            }
+        }
+    }
+}
+
+// Analyse one chunk on the integer path: level, window, FFT and power
+// without converting the samples to floating point. The gain only enters
+// the power scale, so it is constant over the chunk.
+void fixed_point_chunk(const Sint16* samples, double gain, Uint64* mark) {
+    Sint64 energy = 0;
+    for (int i = 0; i < CHUNK_SIZE; ++i) {
+        int x = samples[i];
+        energy += x * x;
+    }
+    double level_scale = gain / MAX_AMPLITUDE;
+    double meter = meter_gain() / MAX_AMPLITUDE;
+    input_rms_db = energy > 0 ? fmax(10.0 * log10((double)energy / CHUNK_SIZE * meter * meter), SILENCE_GATE_MIN_DB)
+                              : SILENCE_GATE_MIN_DB;
+    stage_mark(STAGE_CONVERT, mark);
+    if (silence_gate()) {
+        memset(magnitudes, 0, sizeof(magnitudes));
+        age_tracks(audio_ticks());
+        stage_mark(STAGE_AGEING, mark);
+        return;
+    }
+
+    double powers[FFT_SIZE / 2];
+    fixed_spectrum(samples, level_scale, powers);
+    padded_ready = false;
+    stage_mark(STAGE_FFT, mark);
+
+    Uint32 now = audio_ticks();
+    analyse_frame(NULL, 1.0, powers, now, mark);
+    age_tracks(now);
+    stage_mark(STAGE_AGEING, mark);
+}
+
+// Periodogram of one frame of samples with the current window on the
+// integer path, in the floating-point path's power units
+void fixed_spectrum(const Sint16* samples, double level_scale, double* powers) {
+    // Pack even samples into the real part and odd ones into the imaginary
+    // part, in bit-reversed order, windowing on the way
+    static Sint32 re[FIXED_FFT_POINTS], im[FIXED_FFT_POINTS];
+    const Sint16* window = fixed_windows[window_type];
+    const int shift = 15 - FIXED_FRACTION_BITS;
+    for (int n = 0; n < FIXED_FFT_POINTS; ++n) {
+        int r = fixed_bitrev[n];
+        re[r] = (samples[2 * n] * window[2 * n] + (1 << (shift - 1))) >> shift;
+        im[r] = (samples[2 * n + 1] * window[2 * n + 1] + (1 << (shift - 1))) >> shift;
+    }
+    fixed_fft(re, im);
+
+    // Split into the spectrum of the real frame: 2X[k] = E + W^k O with
+    // E = Z[k] + conj(Z[M-k]) and O = -i (Z[k] - conj(Z[M-k]))
+    // The Q15 window peaks at Q15_ONE / 2^15 of the float window's scale
+    double window_gain = fixed_window_scale[window_type] * Q15_ONE / (double)(1 << 15);
+    double gain_ratio = 0.5 / (window_info[window_type].coherent_gain * window_gain);
+    double unit = level_scale / (1 << FIXED_FRACTION_BITS);
+    double power_scale = 0.25 * unit * unit * gain_ratio * gain_ratio;
+    for (int k = 0; k < FFT_SIZE / 2; ++k) {
+        int c = (FIXED_FFT_POINTS - k) & (FIXED_FFT_POINTS - 1);
+        Sint32 er = re[k] + re[c], ei = im[k] - im[c];
+        Sint32 odd_r = im[k] + im[c], odd_i = re[c] - re[k];
+        const Sint32* w = fixed_twiddle[k];
+        Sint32 xr = er + q30_mul(odd_r, w[0]) - q30_mul(odd_i, w[1]);
+        Sint32 xi = ei + q30_mul(odd_r, w[1]) + q30_mul(odd_i, w[0]);
+        Sint64 power = (Sint64)xr * xr + (Sint64)xi * xi;
+        powers[k] = (double)power * power_scale;
+    }
+}
+
+// --- Frame Batches ---
+// One batched plan per batch size, all on the same buffers
+bool setup_frame_batches(void) {
+    batch_in = fftw_malloc(sizeof(double) * FRAME_OVERLAP_MAX * FFT_SIZE);
+    batch_out = fftw_malloc(sizeof(fftw_complex) * FRAME_OVERLAP_MAX * (FFT_SIZE / 2 + 1));
+    if (!batch_in || !batch_out) {
+        log_error("FFTW memory allocation failed for frame batches.");
+        return false;
+    }
+    int n = FFT_SIZE;
+    for (int b = 0; b < FRAME_OVERLAP_MAX; ++b) {
+        batch_plans[b] = fftw_plan_many_dft_r2c(1, &n, b + 1,
+                                                batch_in, NULL, 1, FFT_SIZE,
+                                                batch_out, NULL, 1, FFT_SIZE / 2 + 1,
+                                                FFTW_ESTIMATE);
+        if (!batch_plans[b]) {
+            log_error("FFTW batched plan creation failed.");
+            return false;
+        }
+    }
+    if (frame_overlap != 1 && frame_overlap != 2 && frame_overlap != FRAME_OVERLAP_MAX) {
+        frame_overlap = 1;
+    }
+    configure_decimation(decimation_stages);
+    return true;
+}
+
+// --- Multi-frame Integration ---
+// SNR threshold on the block mean of INTEGRATION_FRAMES exponential noise
+// bins giving the single-frame false-alarm rate of DETECT_SNR_DB, exp(-T):
+// P(mean > t) = exp(-K t) * sum_{i<K} (K t)^i / i!
+void setup_integration(void) {
+    const int k = INTEGRATION_FRAMES;
+    double log_target = -pow(10.0, DETECT_SNR_DB / 10.0);
+    double lo = 0.0;
+    double hi = -log_target;
+    for (int iter = 0; iter < 100; ++iter) {
+        double mid = 0.5 * (lo + hi);
+        double term = 1.0;
+        double series = 0.0;
+        for (int i = 0; i < k; ++i) {
+            series += term;
+            term *= k * mid / (i + 1);
+        }
+        if (-k * mid + log(series) > log_target) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    integration_snr = hi;
+    reset_integration();
+}
+
+// Drop the current block, e.g. when the bins change meaning
+void reset_integration(void) {
+    memset(integration_sum, 0, sizeof(integration_sum));
+    coherent_count = 0;
+    integration_count = 0;
+    integration_skip = 0;
+}
+
+// Audio time between detections
+double detection_seconds(void) {
+    bool blocks = integration_mode != INTEGRATION_OFF && analysis_mode == ANALYSIS_SINE;
+    return blocks ? INTEGRATION_FRAMES * frame_overlap * frame_seconds : frame_seconds;
+}
+
+// Add a frame to the current block; true once the block is complete. Frames
+// overlapping the last one taken are skipped, since their noise is
+// correlated with it and would not narrow the mean as the thresholds
+// assume. A tone at offset d from candidate bin k turns its bin by
+// 2 pi (k + d) hop / FFT_SIZE between taken frames, which each offset
+// hypothesis rotates back before summing
+bool integrate_frame(const fftw_complex* spec, double spectrum_scale, const double* powers) {
+    if (integration_skip > 0) {
+        integration_skip--;
+        return false;
+    }
+    integration_skip = frame_overlap - 1;
+    for (int i = 0; i < FFT_SIZE / 2; ++i) {
+        integration_sum[i] += powers[i];
+    }
+    if (spec && integration_mode == INTEGRATION_COHERENT) {
+        double amplitude_scale = sqrt(spectrum_scale);
+        double hop = (double)frame_hop() * frame_overlap / FFT_SIZE;
+        for (int c = 0; c < coherent_count; ++c) {
+            CoherentCandidate* cand = &coherent_candidates[c];
+            double re = spec[cand->bin][0] * amplitude_scale;
+            double im = spec[cand->bin][1] * amplitude_scale;
+            for (int h = 0; h < INTEGRATION_HYPOTHESES; ++h) {
+                double offset = (double)h / INTEGRATION_HYPOTHESES - 0.5;
+                double turns = fmod((cand->bin + offset) * hop * integration_count, 1.0);
+                double rot_re = cos(2.0 * M_PI * turns);
+                double rot_im = -sin(2.0 * M_PI * turns);
+                cand->sum[h][0] += re * rot_re - im * rot_im;
+                cand->sum[h][1] += re * rot_im + im * rot_re;
+            }
+        }
+    }
+    return ++integration_count >= INTEGRATION_FRAMES;
+}
+
+// Report the candidates whose phase-aligned block sum, scaled to the
+// per-frame noise level, clears DETECT_SNR_DB over the noise estimate. The
+// bin must still be a maximum of the block mean spectrum, since the phase
+// advance only fixes the offset modulo a bin. The best offset, refined by
+// a parabola through its neighbours, places the tone within the
+// bin; the level comes from the mean spectrum and the SNR is the integrated
+// one. Peaks reported here are claimed from the incoherent passes.
+void coherent_detections(const double* powers, double total_power, const SpectralPeak* peaks, int peak_count,
+                         bool* claimed, double low_hz, Uint32 now) {
+    double threshold = pow(10.0, DETECT_SNR_DB / 10.0);
+    for (int c = 0; c < coherent_count; ++c) {
+        const CoherentCandidate* cand = &coherent_candidates[c];
+        int bin = cand->bin;
+        if (bin < 1 || bin > FFT_SIZE / 2 - 2 || powers[bin] < powers[bin - 1] || powers[bin] < powers[bin + 1]) {
+            continue;
+        }
+        double coherent_power[INTEGRATION_HYPOTHESES];
+        int best = 0;
+        for (int h = 0; h < INTEGRATION_HYPOTHESES; ++h) {
+            coherent_power[h] = (cand->sum[h][0] * cand->sum[h][0] + cand->sum[h][1] * cand->sum[h][1]) / INTEGRATION_FRAMES;
+            if (coherent_power[h] > coherent_power[best]) {
+                best = h;
+            }
+        }
+        int match = -1;
+        for (int j = 0; j < peak_count; ++j) {
+            if (abs(peaks[j].bin - bin) <= suppress_bins) {
+                match = j;
+                break;
+            }
+        }
+        if (match != -1 && (claimed[match] || peaks[match].fundamental != -1)) {
+            continue; // Already reported, or a harmonic that goes with its fundamental
+        }
+        SpectralPeak direct = {.bin = bin, .harmonics = 0};
+        measure_peak(powers, &direct);
+        direct.group_power = direct.power;
+        const SpectralPeak* peak = match != -1 ? &peaks[match] : &direct;
+        double noise = peak_noise(powers, &direct);
+        if (noise <= 0.0 || coherent_power[best] <= threshold * noise) {
+            continue;
+        }
+        double offset = (double)best / INTEGRATION_HYPOTHESES - 0.5;
+        if (best > 0 && best < INTEGRATION_HYPOTHESES - 1) {
+            double left = coherent_power[best - 1];
+            double right = coherent_power[best + 1];
+            double denom = left - 2.0 * coherent_power[best] + right;
+            if (denom < 0.0) {
+                offset += 0.5 * (left - right) / denom / INTEGRATION_HYPOTHESES;
+            }
+        }
+        // The mean spectrum must lean the same way, or this is the neighbour
+        // of a tone whose phase has wrapped into the opposite half of the bin
+        if ((offset > 0.25 && powers[bin + 1] < powers[bin - 1]) ||
+            (offset < -0.25 && powers[bin - 1] < powers[bin + 1])) {
+            continue;
+        }
+        double freq = (bin + offset) * freq_resolution;
+        if (freq < low_hz || freq > bandpass_high_hz) {
+            continue;
+        }
+        double level_db, snr_db;
+        peak_level(powers, &direct, &level_db, &snr_db);
+        snr_db = 10.0 * log10(coherent_power[best] / noise);
+        update_track(freq, peak->group_power / total_power, peak->harmonics, level_db, snr_db, now);
+        if (match != -1) {
+            claimed[match] = true;
+        }
+    }
+}
+
+// Queue a bin for coherent integration unless it is out of range, near a
+// queued one or the list is full
+void add_coherent_candidate(int bin, int lo, int hi) {
+    if (bin < lo || bin > hi || coherent_count == INTEGRATION_CANDIDATES) {
+        return;
+    }
+    for (int c = 0; c < coherent_count; ++c) {
+        if (abs(coherent_candidates[c].bin - bin) <= suppress_bins) {
+            return;
+        }
+    }
+    CoherentCandidate* cand = &coherent_candidates[coherent_count++];
+    cand->bin = bin;
+    memset(cand->sum, 0, sizeof(cand->sum));
+}
+
+// Clear the block sums and pick the next block's coherent candidates: live
+// tracks at their frequency predicted for mid-block, then the strongest
+// fundamentals of this block's mean spectrum, detected or not
+void start_integration_block(const SpectralPeak* peaks, int peak_count, double low_hz) {
+    reset_integration();
+    if (integration_mode != INTEGRATION_COHERENT) {
+        return;
+    }
+    int lo = (int)ceil(low_hz / freq_resolution);
+    lo = lo > detect_lo ? lo : detect_lo;
+    double ahead = 0.5 * detection_seconds();
+    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+        if (tracks.start_time[i] != 0) {
+            add_coherent_candidate((int)lround((tracks.freq[i] + tracks.rate[i] * ahead) / freq_resolution), lo, detect_hi);
+        }
+    }
+    int by_rank[MAX_PEAK_CANDIDATES];
+    for (int i = 0; i < peak_count; ++i) {
+        by_rank[peaks[i].rank] = i;
+    }
+    for (int r = 0; r < peak_count; ++r) {
+        const SpectralPeak* peak = &peaks[by_rank[r]];
+        if (peak->fundamental == -1) {
+            add_coherent_candidate(peak->bin, lo, detect_hi);
+        }
+    }
+}
+
+// --- Zero Padding ---
+bool setup_zero_padding(void) {
+    padded_in = fftw_malloc(sizeof(double) * ZERO_PAD_MAX * FFT_SIZE);
+    padded_out = fftw_malloc(sizeof(fftw_complex) * (ZERO_PAD_MAX * FFT_SIZE / 2 + 1));
+    if (!padded_in || !padded_out) {
+        log_error("FFTW memory allocation failed for zero padding.");
+        return false;
+    }
+    memset(padded_in, 0, sizeof(double) * ZERO_PAD_MAX * FFT_SIZE);
+    for (int i = 1; i < ZERO_PAD_PLANS; ++i) {
+        plan_threads_for(FFT_SIZE << i);
+        padded_plans[i] = fftw_plan_dft_r2c_1d(FFT_SIZE << i, padded_in, padded_out, FFTW_ESTIMATE);
+    }
+    plan_threads_for(FFT_SIZE);
+    if (zero_pad_index(zero_pad) < 0) {
+        zero_pad = 1;
+    }
+    return true;
+}
+
+// Plan index for a padding factor, or -1 when it is not supported
+int zero_pad_index(int factor) {
+    for (int i = 0; i < ZERO_PAD_PLANS; ++i) {
+        if (factor == 1 << i) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Offset from bin of the tone's peak on the padded grid, searched between the
+// neighbouring bins and refined by a log-parabola, which is nearly unbiased
+// at this density. The spectrum of a real frame is symmetric about 0 Hz, so
+// for bin 1 the point below the grid is read from its mirror image.
+double padded_offset(int bin) {
+    int lo = (bin - 1) * zero_pad;
+    int hi = (bin + 1) * zero_pad;
+    double power[3 * ZERO_PAD_MAX + 1];
+    for (int k = lo - 1; k <= hi + 1; ++k) {
+        const fftw_complex* x = &padded_out[abs(k)];
+        power[k - lo + 1] = ((*x)[0] * (*x)[0] + (*x)[1] * (*x)[1]) * padded_scale;
+    }
+    int best = lo;
+    for (int k = lo + 1; k <= hi; ++k) {
+        if (power[k - lo + 1] > power[best - lo + 1]) {
+            best = k;
+        }
+    }
+    double offset = lobe_offset(power, best - lo + 1, 1, false);
+    return (best + offset) / zero_pad - bin;
+}
+
+// --- Windows ---
+// Zeroth-order modified Bessel function of the first kind (power series)
+double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 200 && term > 1e-17 * sum; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Chebyshev polynomial T_order(x), valid outside [-1, 1] as well
+double chebyshev_poly(int order, double x) {
+    if (x > 1.0) {
+        return cosh(order * acosh(x));
+    }
+    if (x < -1.0) {
+        return (order % 2 ? -1.0 : 1.0) * cosh(order * acosh(-x));
+    }
+    return cos(order * acos(x));
+}
+
+// Build every periodogram window and its constants. The lobe half-width and
+// bias table come from the window's DTFT evaluated at fractional offsets,
+// so they match whichever interpolator the half-width selects.
+bool setup_windows(void) {
+    const int n = FFT_SIZE;
+    for (int i = 0; i < n; ++i) {
+        double phase = 2.0 * M_PI * i / (n - 1);
+        window_tables[WINDOW_HANN][i] = 0.5 * (1.0 - cos(phase));
+        window_tables[WINDOW_BLACKMAN_HARRIS][i] = 0.35875 - 0.48829 * cos(phase) +
+                                                   0.14128 * cos(2.0 * phase) - 0.01168 * cos(3.0 * phase);
+        window_tables[WINDOW_FLAT_TOP][i] = 0.21557895 - 0.41663158 * cos(phase) + 0.277263158 * cos(2.0 * phase) -
+                                            0.083578947 * cos(3.0 * phase) + 0.006947368 * cos(4.0 * phase);
+        double r = 2.0 * i / (n - 1) - 1.0;
+        window_tables[WINDOW_KAISER][i] = bessel_i0(kaiser_beta * sqrt(fmax(0.0, 1.0 - r * r))) / bessel_i0(kaiser_beta);
+    }
+
+    // Dolph-Chebyshev: sample the Chebyshev response around the unit circle
+    // and transform back, with a half-sample shift for the even length
+    fftw_complex* cheb = fftw_malloc(sizeof(fftw_complex) * n);
+    if (!cheb) {
+        log_error("Failed to allocate window memory");
+        return false;
+    }
+    fftw_plan cheb_plan = fftw_plan_dft_1d(n, cheb, cheb, FFTW_FORWARD, FFTW_ESTIMATE);
+    double x0 = cosh(acosh(pow(10.0, CHEBYSHEV_ATTENUATION_DB / 20.0)) / (n - 1));
+    for (int k = 0; k < n; ++k) {
+        double value = chebyshev_poly(n - 1, x0 * cos(M_PI * k / n));
+        cheb[k][0] = value * cos(M_PI * k / n);
+        cheb[k][1] = value * sin(M_PI * k / n);
+    }
+    fftw_execute(cheb_plan);
+    double* w = window_tables[WINDOW_CHEBYSHEV];
+    for (int i = 1; i <= n / 2; ++i) {
+        w[n / 2 - i] = cheb[i][0];
+        w[n / 2 + i - 1] = cheb[i][0];
+    }
+    double peak = 0.0;
+    for (int i = 0; i < n; ++i) {
+        peak = fmax(peak, w[i]);
+    }
+    for (int i = 0; i < n; ++i) {
+        w[i] /= peak;
+    }
+    fftw_destroy_plan(cheb_plan);
+    fftw_free(cheb);
+
+    for (int t = 0; t < WINDOW_COUNT; ++t) {
+        const double* win = window_tables[t];
+        WindowInfo* info = &window_info[t];
+        double sum = 0.0;
+        double sum_sq = 0.0;
+        for (int i = 0; i < n; ++i) {
+            sum += win[i];
+            sum_sq += win[i] * win[i];
+        }
+        info->coherent_gain = sum / n;
+        info->enbw = n * sum_sq / (sum * sum);
+
+        double response[2 * WINDOW_RESPONSE_SPAN + 1];
+        const int centre = WINDOW_RESPONSE_SPAN;
+        window_response(win, 0.0, response);
+        info->halfwidth = WINDOW_RESPONSE_SPAN - 1;
+        double lobe = response[centre];
+        for (int h = 1; h < WINDOW_RESPONSE_SPAN; ++h) {
+            lobe += response[centre - h] + response[centre + h];
+            if (lobe >= WINDOW_LOBE_ENERGY * n * sum_sq) {
+                info->halfwidth = h;
+                break;
+            }
+        }
+
+        // Interpolated offset for evenly spaced true offsets, then inverted
+        // onto an even grid of interpolated offsets
+        bool centroid = info->halfwidth > 1;
+        double true_offset[WINDOW_BIAS_POINTS];
+        double measured[WINDOW_BIAS_POINTS];
+        for (int j = 0; j < WINDOW_BIAS_POINTS; ++j) {
+            true_offset[j] = -0.5 + (double)j / (WINDOW_BIAS_POINTS - 1);
+            window_response(win, true_offset[j], response);
+            measured[j] = lobe_offset(response, centre, info->halfwidth, centroid);
+        }
+        for (int j = 0; j < WINDOW_BIAS_POINTS; ++j) {
+            double target = -0.5 + (double)j / (WINDOW_BIAS_POINTS - 1);
+            int m = 1;
+            while (m < WINDOW_BIAS_POINTS - 1 && measured[m] < target) {
+                m++;
+            }
+            double span = measured[m] - measured[m - 1];
+            double frac = span > 0.0 ? (target - measured[m - 1]) / span : 0.0;
+            frac = fmin(fmax(frac, 0.0), 1.0);
+            info->bias[j] = true_offset[m - 1] + frac * (true_offset[m] - true_offset[m - 1]);
+        }
+    }
+    return true;
+}
+
+// Power |W(k - offset)|^2 in bins k = -WINDOW_RESPONSE_SPAN..WINDOW_RESPONSE_SPAN
+// of a unit tone offset from the centre bin, from the window's DTFT. The
+// complex exponential is advanced by rotation rather than per-sample trig.
+void window_response(const double* win, double offset, double* response) {
+    for (int k = -WINDOW_RESPONSE_SPAN; k <= WINDOW_RESPONSE_SPAN; ++k) {
+        double step = -2.0 * M_PI * (k - offset) / FFT_SIZE;
+        double step_re = cos(step), step_im = sin(step);
+        double rot_re = 1.0, rot_im = 0.0;
+        double re = 0.0, im = 0.0;
+        for (int i = 0; i < FFT_SIZE; ++i) {
+            re += win[i] * rot_re;
+            im += win[i] * rot_im;
+            double next_re = rot_re * step_re - rot_im * step_im;
+            rot_im = rot_re * step_im + rot_im * step_re;
+            rot_re = next_re;
+        }
+        response[k + WINDOW_RESPONSE_SPAN] = re * re + im * im;
+    }
+}
+
+void set_window(int type) {
+    window_type = type;
+    taper_banks[SPECTRUM_PERIODOGRAM].peak_halfwidth = window_info[type].halfwidth;
+    set_spectral_mode(spectral_mode);
+}
+
+void set_spectral_mode(int mode) {
+    spectral_mode = mode;
+    peak_halfwidth = taper_banks[mode].peak_halfwidth;
+    suppress_bins = peak_halfwidth + 1 > PEAK_SUPPRESS_BINS ? peak_halfwidth + 1 : PEAK_SUPPRESS_BINS;
+    // Flat-topped lobes and channels carry no curvature to fit a parabola to
+    centroid_interpolation = peak_halfwidth > 1 || mode == SPECTRUM_POLYPHASE;
+    if (mode == SPECTRUM_PERIODOGRAM) {
+        lobe_enbw = window_info[window_type].enbw;
+    } else if (mode == SPECTRUM_POLYPHASE) {
+        lobe_enbw = polyphase.enbw;
+    } else {
+        lobe_enbw = taper_banks[mode].enbw;
+    }
+    frame_seconds = frame_hop() / (freq_resolution * FFT_SIZE);
+    reset_integration();
+}
+
+// Multiply the frame by every taper in the bank, run the batched FFT and
+// write the scaled mean power per bin
+void estimate_tapered_spectrum(TaperBank* bank, const double* samples, double* powers) {
+    for (int k = 0; k < bank->count; ++k) {
+        const double* w = bank->window + k * FFT_SIZE;
+        double* in = bank->in + k * FFT_SIZE;
+        for (int i = 0; i < FFT_SIZE; ++i) {
+            in[i] = samples[i] * w[i];
+        }
+    }
+    fftw_execute(bank->plan);
+    double scale = bank->scale / bank->count;
+    for (int i = 0; i < FFT_SIZE / 2; ++i) {
+        double sum = 0.0;
+        for (int k = 0; k < bank->count; ++k) {
+            const fftw_complex* bin = &bank->out[k * (FFT_SIZE / 2 + 1) + i];
+            sum += (*bin)[0] * (*bin)[0] + (*bin)[1] * (*bin)[1];
+        }
+        powers[i] = sum * scale;
+    }
+}
+
+// Associate a measured peak with the live track whose predicted frequency is
+// nearest relative to its gate, or start a new track in a free slot
+void update_track(double freq, double purity, int harmonics, double level_db, double snr_db, Uint32 now) {
+    // Gated distance to every slot in one pass; free slots and tracks already
+    // updated this frame score above any gate
+    double gate[MAX_TRACKED_SINES], score[MAX_TRACKED_SINES];
+    track_gates(gate);
+    Uint32 frame = (Uint32)analysis_frame;
+    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+        bool open = (tracks.start_time[i] != 0) & (tracks.last_frame[i] != frame);
+        score[i] = fabs(tracks.predicted[i] - freq) / gate[i] + (open ? 0.0 : HUGE_VAL);
+    }
+    int match = -1;
+    double best = 1.0;
+    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+        if (score[i] <= best) {
+            best = score[i];
+            match = i;
+        }
+    }
+    if (match != -1) {
+        track_measure(match, freq, purity, harmonics, level_db, snr_db, now);
+        return;
+    }
+    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+        if (tracks.start_time[i] == 0) {
+            tracks.freq[i] = freq;
+            tracks.purity[i] = purity * 100.0;
+            tracks.harmonics[i] = harmonics;
+            tracks.level_db[i] = level_db;
+            tracks.peak_db[i] = level_db;
+            tracks.snr_db[i] = snr_db;
+            tracks.rate[i] = 0.0;
+            tracks.predicted[i] = freq;
+            tracks.predicted_bin[i] = -1;
+            tracks.updates[i] = 1;
+            tracks.last_frame[i] = (Uint32)analysis_frame;
+            tracks.start_time[i] = now;
+            tracks.last_seen[i] = now;
+            tracks.active[i] = false;
+            return;
+        }
+    }
+}
+
+// Fold a measurement into a track's alpha-beta state. The second measurement
+// seeds the slope directly so a sweep is locked within two frames.
+void track_measure(int i, double freq, double purity, int harmonics, double level_db, double snr_db, Uint32 now) {
+    double dt = (double)((Uint32)analysis_frame - tracks.last_frame[i]) * frame_seconds;
+    if (tracks.updates[i] == 1 && dt > 0.0) {
+        tracks.rate[i] = (freq - tracks.freq[i]) / dt;
+        tracks.freq[i] = freq;
+    } else {
+        double residual = freq - tracks.predicted[i];
+        tracks.freq[i] = tracks.predicted[i] + TRACK_ALPHA * residual;
+        if (dt > 0.0) {
+            tracks.rate[i] += TRACK_BETA * residual / dt;
+        }
+    }
+    tracks.predicted[i] = tracks.freq[i];
+    tracks.purity[i] = purity * 100.0;
+    tracks.harmonics[i] = harmonics;
+    tracks.level_db[i] = level_db;
+    tracks.peak_db[i] = fmax(tracks.peak_db[i], level_db);
+    tracks.snr_db[i] = snr_db;
+    tracks.updates[i]++;
+    tracks.last_frame[i] = (Uint32)analysis_frame;
+    tracks.last_seen[i] = now;
+}
+
+// Half-width in Hz of the association gate around each slot's prediction. A
+// track with a single measurement has no slope yet, so it accepts anything
+// reachable at SWEEP_MAX_RATE; afterwards the gate only widens with the
+// distance the tone is predicted to have moved. Free slots are computed too,
+// which keeps the pass branch-free; callers ignore them.
+void track_gates(double* gate) {
+    // Written as selects rather than branches so the loop can vectorise.
+    // GCC 12 does so only with masked vectors: at -O3 with -mavx512f (or
+    // -march=native on an AVX-512 machine), but not at -O2 or with AVX2.
+    // Live tracks are at most a few hundred frames old, so the age fits an
+    // int; a free slot's age may be anything, but its gate is never used.
+    Uint32 frame = (Uint32)analysis_frame;
+    double reach_limit = 2.0 * frame_seconds;
+    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+        double dt = (int)(frame - tracks.last_frame[i]) * frame_seconds;
+        double reach = SWEEP_MAX_RATE * (dt < reach_limit ? dt : reach_limit);
+        double drift = fabs(tracks.rate[i]) * dt * SWEEP_GATE_FRACTION;
+        gate[i] = FREQUENCY_TOLERANCE + (tracks.updates[i] < 2 ? reach : drift);
+    }
+}
+
+// Extrapolate every live track to the current frame and find the strongest
+// local maximum inside its gate, so a tracked tone is measured even when the
+// global peak search ranks it out. This is extra work on top of that search,
+// not a replacement for it; only the tracked search (search_ranges) narrows
+// the bins the peak search visits.
+void predict_tracks(const double* powers, int n) {
+    double gate[MAX_TRACKED_SINES];
+    track_gates(gate);
+    Uint32 frame = (Uint32)analysis_frame;
+    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+        double dt = (int)(frame - tracks.last_frame[i]) * frame_seconds;
+        tracks.predicted[i] = tracks.freq[i] + tracks.rate[i] * dt;
+        tracks.predicted_bin[i] = -1;
+    }
+    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+        if (tracks.start_time[i] == 0) {
+            continue;
+        }
+        int lo = (int)floor((tracks.predicted[i] - gate[i]) / freq_resolution);
+        int hi = (int)ceil((tracks.predicted[i] + gate[i]) / freq_resolution);
+        if (lo < 1) lo = 1;
+        if (hi > n - 2) hi = n - 2;
+        double best_power = 0.0;
+        for (int k = lo; k <= hi; ++k) {
+            double power = powers[k];
+            if (power > best_power && power > powers[k - 1] && power >= powers[k + 1]) {
+                best_power = power;
+                tracks.predicted_bin[i] = k;
+            }
+        }
+    }
+}
+
+// --- Audio Callback Function ---
+// This function is called by SDL whenever it has a new chunk of audio data
+void audio_callback(void* userdata, Uint8* stream, int len) {
+    Sint16* pcm_stream = (Sint16*)stream;
+    Uint64 mark = bench_mode ? SDL_GetPerformanceCounter() : 0;
+    double gain_start, gain_end;
+    chunk_gain(pcm_stream, &gain_start, &gain_end);
+    if (analysis_mode == ANALYSIS_DTMF) {
+        // The Goertzel bank works on raw samples; skip windowing and the FFT
+        stage_mark(STAGE_CONVERT, &mark);
+        dtmf_process(&dtmf, pcm_stream, CHUNK_SIZE, gain_end);
+        stage_mark(STAGE_DTMF, &mark);
+        memset(magnitudes, 0, sizeof(magnitudes));
+        memset(&tracks, 0, sizeof(tracks));
+        return;
+    }
+    if (analysis_mode == ANALYSIS_COUNTER) {
+        // One measurement per chunk feeds the tracker directly
+        stage_mark(STAGE_CONVERT, &mark);
+        frame_seconds = (double)CHUNK_SIZE / SAMPLE_RATE;
+        analysis_frame++;
+        Uint32 now = audio_ticks();
+        counter_process(&counter, pcm_stream, CHUNK_SIZE, gain_end, now);
+        stage_mark(STAGE_COUNTER, &mark);
+        memset(magnitudes, 0, sizeof(magnitudes));
+        age_tracks(now);
+        stage_mark(STAGE_AGEING, &mark);
+        return;
+    }
+    // Reconfigure the decimator whenever the upper cutoff has moved
+    int stages = fixed_path_active() ? 0 : decimation_stages_for(bandpass_high_hz);
+    if (stages != decimation_stages) {
+        configure_decimation(stages);
+    }
+    if (fixed_path_active()) {
+        // The integer path keeps no full-rate float stream to demodulate
+        for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+            demods[i].start_time = 0;
+        }
+        fixed_point_chunk(pcm_stream, gain_end, &mark);
+        return;
+    }
+
+    double converted[CHUNK_SIZE];
+    convert_chunk(pcm_stream, gain_start, gain_end, converted);
+    stage_mark(STAGE_CONVERT, &mark);
+    if (silence_gate()) {
+        memset(magnitudes, 0, sizeof(magnitudes));
+        age_tracks(audio_ticks());
+        stage_mark(STAGE_AGEING, &mark);
+        return;
+    }
+    // Band-limit in the time domain so out-of-band energy cannot leak
+    // through the window sidelobes into in-band bins
+    double filtered[CHUNK_SIZE];
+    biquad_filter(&prefilter, converted, filtered, CHUNK_SIZE);
+    lowband_push(filtered);
+    stage_mark(STAGE_PREFILTER, &mark);
+    demodulate_tracks(filtered);
+    stage_mark(STAGE_DEMOD, &mark);
+    int frames = gather_frames(filtered);
+    stage_mark(STAGE_CONVERT, &mark);
+    if (frames == 0) {
+        return; // Frame not complete yet at the decimated rate
+    }
+
+    Uint32 now = audio_ticks();
+    int hop = frame_hop();
+    TaperBank* bank = taper_banks[spectral_mode].count > 0 ? &taper_banks[spectral_mode] : NULL;
+    bool periodogram = !bank && spectral_mode != SPECTRUM_POLYPHASE;
+    if (periodogram) {
+        // Window every ready frame into the batch and transform them together
+        const double* window = window_tables[window_type];
+        for (int f = 0; f < frames; ++f) {
+            const double* frame = analysis_samples + f * hop;
+            double* in = batch_in + f * FFT_SIZE;
+            for (int i = 0; i < FFT_SIZE; ++i) {
+                in[i] = frame[i] * window[i];
+            }
+        }
+        fftw_execute(batch_plans[frames - 1]);
+    }
+    for (int f = 0; f < frames; ++f) {
+        const double* frame = analysis_samples + f * hop;
+        double powers[FFT_SIZE / 2];
+        const fftw_complex* spec = NULL;
+        const double* windowed = NULL;
+        double spectrum_scale = 1.0;
+        if (spectral_mode == SPECTRUM_POLYPHASE) {
+            polyphase_frame(frame);
+            fftw_execute(p);
+            spec = out;
+            windowed = pcm_buffer;
+            spectrum_scale = polyphase.scale;
+        } else if (bank) {
+            // Averaged estimators taper the raw frame themselves
+            estimate_tapered_spectrum(bank, frame, powers);
+        } else {
+            spec = batch_out + f * (FFT_SIZE / 2 + 1);
+            windowed = batch_in + f * FFT_SIZE;
+            // Put every window on the Hann full-scale level
+            double gain_ratio = 0.5 / window_info[window_type].coherent_gain;
+            spectrum_scale = gain_ratio * gain_ratio;
+        }
+        padded_ready = false;
+        if (zero_pad > 1 && windowed) {
+            memcpy(padded_in, windowed, sizeof(double) * FFT_SIZE);
+            fftw_execute(padded_plans[zero_pad_index(zero_pad)]);
+            padded_scale = spectrum_scale;
+            padded_ready = true;
+        }
+        stage_mark(STAGE_FFT, &mark);
+        analyse_frame(spec, spectrum_scale, powers, now, &mark);
+    }
+    analysis_len -= frames * hop;
+    memmove(analysis_samples, analysis_samples + frames * hop, sizeof(double) * analysis_len);
+
+    // Low band: one time-domain pitch estimate per callback. The level is
+    // that of a sine with the window's RMS, and the periodicity p gives the
+    // harmonics-to-noise ratio p / (1 - p)
+    double low_freq, periodicity, rms;
+    if (lowband_active() && lowband_pitch(&low_freq, &periodicity, &rms) &&
+        low_freq >= bandpass_low_hz && low_freq < LOWBAND_MAX_HZ) {
+        double level_db = 20.0 * log10(sqrt(2.0) * rms) - (agc_enabled ? chunk_gain_db : 0.0);
+        double snr_db = periodicity < 1.0 ? 10.0 * log10(periodicity / (1.0 - periodicity)) : HUGE_VAL;
+        update_track(low_freq, periodicity, 0, level_db, snr_db, now);
+    }
+    stage_mark(STAGE_LOWBAND, &mark);
+
+    age_tracks(now);
+    stage_mark(STAGE_AGEING, &mark);
+}
+
+// Spectrum, detection and tracking for one frame. spec holds its FFT, to be
+// scaled by spectrum_scale, or is NULL when powers already holds an
+// averaged estimate.
+void analyse_frame(const fftw_complex* spec, double spectrum_scale, double* powers, Uint32 now, Uint64* mark) {
+    analysis_frame++;
+    frame_gain_db = chunk_gain_db;
+    double total_power = 0.0;
+
+    for (int i = 0; i < FFT_SIZE / 2; ++i) {
+        double power;
+        if (spec) {
+            power = (spec[i][0] * spec[i][0] + spec[i][1] * spec[i][1]) * spectrum_scale;
+        } else {
+            power = powers[i];
+        }
+        double freq = i * freq_resolution;
+        if (freq < bandpass_low_hz || freq > bandpass_high_hz) {
+            power = 0.0; // Hard band edge; the prefilter has already removed the leakage
+        }
+        if (averaging_enabled) {
+            avg_powers[i] = AVERAGING_ALPHA * power + (1.0 - AVERAGING_ALPHA) * avg_powers[i];
+            power = avg_powers[i];
+        } else {
+            avg_powers[i] = power;
+        }
+        powers[i] = power;
+    }
+    stage_mark(STAGE_SPECTRUM, mark);
+
+    /*
+     * Normalize spectrum magnitudes against the theoretical maximum power of a
+     * full-scale sine wave so that input gain changes are reflected in the
+     * visualization. Previously the magnitudes were normalised by the maximum
+     * power of the current frame, which hid overall amplitude variations.
+     *
+     * For a Hann-windowed, full-scale sine wave the peak power is roughly
+     * (FFT_SIZE/4)^2.  Scaling by this constant keeps magnitudes in the
+     * 0.0-1.0 range while allowing gain adjustments to impact the display.
+     * The averaged estimators are pre-scaled to the same full-scale peak.
+     */
+    double max_possible_power = (FFT_SIZE / 4.0) * (FFT_SIZE / 4.0);
+    total_power = 0.0;
+    for (int i = 0; i < FFT_SIZE / 2; ++i) {
+        double norm = powers[i] / max_possible_power;
+        if (norm > 1.0) {
+            norm = 1.0;
+        }
+        if (squelch_enabled && norm < squelch_threshold) {
+            powers[i] = 0.0;
+            norm = 0.0;
+        }
+        magnitudes[i] = norm;
+        total_power += powers[i];
+    }
+
+    // Integrated detection waits for the end of the block and then works on
+    // its mean spectrum; the display above still follows every frame
+    if (integration_mode != INTEGRATION_OFF) {
+        if (!integrate_frame(spec, spectrum_scale, powers)) {
+            stage_mark(STAGE_NORMALIZE, mark);
+            return;
+        }
+        total_power = 0.0;
+        for (int i = 0; i < FFT_SIZE / 2; ++i) {
+            powers[i] = integration_sum[i] / INTEGRATION_FRAMES;
+            total_power += powers[i];
+        }
+        padded_ready = false; // The padded spectrum only covers the last frame
+    }
+
+    // Look at each tracked tone's predicted bins before the full search
+    predict_tracks(powers, FFT_SIZE / 2);
+    stage_mark(STAGE_PREDICT, mark);
+
+    // Bins to search: everything on an acquisition scan, else the tracked windows
+    BinRange search[MAX_SEARCH_RANGES];
+    int search_count = search_ranges(total_power, search);
+    bool full_scan = search_count == 1 && search[0].lo == 1 && search[0].hi == FFT_SIZE / 2 - 2;
+
+    // Noise reference over the pass band for the detection statistic:
+    // the local floor, or running sums for the CFAR training windows. The
+    // tracked windows only need the floor around themselves, taken over
+    // ranges wide enough for it to match the full-band estimate there.
+    detect_lo = (int)ceil(bandpass_low_hz / freq_resolution);
+    detect_hi = (int)floor(bandpass_high_hz / freq_resolution);
+    if (detect_lo < 0) detect_lo = 0;
+    if (detect_hi > FFT_SIZE / 2 - 1) detect_hi = FFT_SIZE / 2 - 1;
+    if (detector_mode == DETECTOR_LOCAL_SNR) {
+        memset(noise_floor, 0, sizeof(noise_floor));
+        if (full_scan) {
+            estimate_noise_floor(powers, detect_lo, detect_hi, noise_floor);
+        } else {
+            BinRange reference[MAX_SEARCH_RANGES];
+            memcpy(reference, search, sizeof(BinRange) * search_count);
+            int reference_count = merge_ranges(reference, search_count, NOISE_FLOOR_PASSES * NOISE_FLOOR_HALFWIDTH,
+                                               detect_lo, detect_hi);
+            for (int r = 0; r < reference_count; ++r) {
+                estimate_noise_floor(powers, reference[r].lo, reference[r].hi, noise_floor);
+            }
+        }
+    } else if (detector_mode == DETECTOR_CA_CFAR) {
+        cfar_prefix[0] = 0.0;
+        cfar_live[0] = 0;
+        for (int i = 0; i < FFT_SIZE / 2; ++i) {
+            double in_band = (i >= detect_lo && i <= detect_hi) ? powers[i] : 0.0;
+            cfar_prefix[i + 1] = cfar_prefix[i] + in_band;
+            cfar_live[i + 1] = cfar_live[i] + (in_band > 0.0);
+        }
+    }
+    stage_mark(STAGE_NORMALIZE, mark);
+
+    // Find top peaks while merging nearby bins to avoid duplicate detections.
+    // A full candidate list from the last scan sets the floor for the tracked
+    // windows, so they do not promote noise maxima the full search would have
+    // ranked out, for instance as harmonics.
+    // Maxima wholly below the lowest reported frequency could never be
+    // detected, so they are neither collected nor measured. This also keeps
+    // measure_peak, and with it padded_offset, away from bin 1 unless the
+    // band reaches down there; the mirrored read covers that remaining case.
+    // Sub-band maxima no longer take candidate slots from in-band ones.
+    SpectralPeak peaks[MAX_PEAK_CANDIDATES];
+    double fft_low_hz = lowband_active() ? LOWBAND_MAX_HZ : bandpass_low_hz;
+    int low_bin = (int)floor(fft_low_hz / freq_resolution) - 1;
+    search_count = merge_ranges(search, search_count, 0, low_bin > 1 ? low_bin : 1, FFT_SIZE / 2 - 2);
+    build_max_pyramid(&peak_pyramid, powers, FFT_SIZE / 2);
+    int peak_count = find_peaks(&peak_pyramid, search, search_count, full_scan ? 0.0 : candidate_floor, peaks,
+                                MAX_PEAK_CANDIDATES);
+    if (full_scan) {
+        candidate_floor = peak_count == MAX_PEAK_CANDIDATES ? peaks[peak_count - 1].bin_power : 0.0;
+    }
+    stage_mark(STAGE_PEAKS, mark);
+
+    // Fold harmonics into their fundamentals so a distorted tone takes one track
+    group_harmonics(peaks, peak_count);
+    stage_mark(STAGE_HARMONICS, mark);
+
+    // Tracked tones first: measure the peak found at each predicted bin,
+    // taking its harmonic group from the candidate list when it is there
+    bool claimed[MAX_PEAK_CANDIDATES] = {false};
+    if (integration_mode == INTEGRATION_COHERENT && total_power > 0.0) {
+        coherent_detections(powers, total_power, peaks, peak_count, claimed, fft_low_hz, now);
+    }
+    for (int t = 0; t < MAX_TRACKED_SINES && total_power > 0.0; ++t) {
+        if (tracks.predicted_bin[t] == -1 || tracks.last_frame[t] == (Uint32)analysis_frame) {
+            continue;
+        }
+        bool taken = false;
+        for (int u = 0; u < t; ++u) {
+            if (tracks.last_frame[u] == (Uint32)analysis_frame &&
+                abs(tracks.predicted_bin[u] - tracks.predicted_bin[t]) <= suppress_bins) {
+                taken = true;
+            }
+        }
+        if (taken) {
+            continue;
+        }
+        SpectralPeak direct = {.bin = tracks.predicted_bin[t], .harmonics = 0};
+        measure_peak(powers, &direct);
+        direct.group_power = direct.power;
+        const SpectralPeak* peak = &direct;
+        for (int j = 0; j < peak_count; ++j) {
+            if (!claimed[j] && peaks[j].fundamental == -1 &&
+                abs(peaks[j].bin - direct.bin) <= suppress_bins) {
+                claimed[j] = true;
+                peak = &peaks[j];
+                break;
+            }
+        }
+        double purity = peak->group_power / total_power;
+        if (peak_detected(powers, peak) &&
+            peak->interp_freq >= fft_low_hz &&
+            peak->interp_freq <= bandpass_high_hz) {
+            double level_db, snr_db;
+            peak_level(powers, peak, &level_db, &snr_db);
+            track_measure(t, peak->interp_freq, purity, peak->harmonics, level_db, snr_db, now);
+        }
+    }
+
+    // Offer the remaining fundamentals to the tracker strongest first
+    int by_rank[MAX_PEAK_CANDIDATES];
+    for (int i = 0; i < peak_count; ++i) {
+        by_rank[peaks[i].rank] = i;
+    }
+    for (int r = 0; r < peak_count; ++r) {
+        const SpectralPeak* peak = &peaks[by_rank[r]];
+        if (peak->fundamental != -1 || claimed[by_rank[r]] || total_power == 0.0) {
+            continue;
+        }
+        double freq = peak->interp_freq;
+        double purity = peak->group_power / total_power;
+        if (peak_detected(powers, peak) &&
+            freq >= fft_low_hz &&
+            freq <= bandpass_high_hz) {
+            double level_db, snr_db;
+            peak_level(powers, peak, &level_db, &snr_db);
+            update_track(freq, purity, peak->harmonics, level_db, snr_db, now);
+        }
+    }
+    if (integration_mode != INTEGRATION_OFF) {
+        start_integration_block(peaks, peak_count, fft_low_hz);
+    }
+    stage_mark(STAGE_DETECT, mark);
+}
+
+// Promote pending tracks that have persisted and drop lost ones. Decimated
+// frames and integration blocks can arrive less often than chunks, so tracks
+// are held for the extra detection interval before being declared lost
+void age_tracks(Uint32 now) {
+    double extra_seconds = fmax(detection_seconds() - (double)CHUNK_SIZE / SAMPLE_RATE, 0.0);
+    Uint32 hold_ms = (Uint32)persistence_threshold_ms + (Uint32)(extra_seconds * 1000.0);
+    // One select-only pass over the slot vectors
+    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+        Uint32 active = tracks.active[i];
+        Uint32 promote = (active == 0) & (tracks.start_time[i] != 0) &
+                         (now - tracks.start_time[i] >= (Uint32)persistence_threshold_ms);
+        Uint32 lost = (active != 0) & (now - tracks.last_seen[i] >= hold_ms);
+        tracks.active[i] = (active | promote) > lost;
+        tracks.last_seen[i] = promote ? now : tracks.last_seen[i];
+        tracks.start_time[i] = lost ? 0 : tracks.start_time[i];
+    }
+}
+
+// Per-bin noise floor over bins lo..hi: a running mean across
+// +-NOISE_FLOOR_HALFWIDTH bins, shrinking at the band edges so zeroed
+// out-of-band bins do not pull it down. The first pass averages log power,
+// which a few strong tone bins barely move (exp(Euler gamma) undoes the log
+// bias for noise bins); later passes average linear power with bins above
+// NOISE_FLOOR_CLIP times the previous estimate clipped, so tones drop out
+// of the mean around themselves. Squelched (zero) bins are not counted,
+// and a bin with none counted around it gets the squelch level. O(N) per
+// pass. Bins outside lo..hi are left untouched; inside, a bin more than
+// NOISE_FLOOR_PASSES half-widths from lo and hi does not depend on where
+// the range ends.
+void estimate_noise_floor(const double* powers, int lo, int hi, double* floor_out) {
+    static const double euler_gamma = 0.5772156649;
+    double values[FFT_SIZE / 2];
+    if (hi < lo) {
+        return;
+    }
+    double fallback = squelch_power();
+    for (int pass = 0; pass < NOISE_FLOOR_PASSES; ++pass) {
+        for (int i = lo; i <= hi; ++i) {
+            if (powers[i] <= 0.0) {
+                values[i] = 0.0;
+            } else if (pass == 0) {
+                values[i] = log(powers[i]);
+            } else {
+                double limit = NOISE_FLOOR_CLIP * floor_out[i];
+                values[i] = powers[i] > limit ? limit : powers[i];
+            }
+        }
+        double sum = 0.0;
+        int live = 0;
+        int first = lo;
+        int last = lo - 1;
+        for (int i = lo; i <= hi; ++i) {
+            while (last < hi && last < i + NOISE_FLOOR_HALFWIDTH) {
+                ++last;
+                sum += values[last];
+                live += powers[last] > 0.0;
+            }
+            while (first < i - NOISE_FLOOR_HALFWIDTH) {
+                sum -= values[first];
+                live -= powers[first] > 0.0;
+                first++;
+            }
+            if (live == 0) {
+                floor_out[i] = fallback;
+            } else if (pass == 0) {
+                floor_out[i] = exp(sum / live + euler_gamma);
+            } else {
+                floor_out[i] = sum > 0.0 ? sum / live : 0.0;
+            }
+        }
+    }
+}
+
+// Peak bin power relative to the local noise floor; a silent background
+// makes any remaining peak stand out infinitely
+double peak_snr(const SpectralPeak* peak) {
+    double floor_power = noise_floor[peak->bin];
+    if (floor_power <= 0.0) {
+        return peak->bin_power > 0.0 ? HUGE_VAL : 0.0;
+    }
+    return peak->bin_power / floor_power;
+}
+
+// Power below which the squelch zeroes a bin; 0 with the squelch off. The
+// spectra are scaled so a full-scale sine peaks at (FFT_SIZE/4)^2.
+double squelch_power(void) {
+    return squelch_enabled ? squelch_threshold * (FFT_SIZE / 4.0) * (FFT_SIZE / 4.0) : 0.0;
+}
+
+// CFAR threshold factors for every training cell count, so cells lost at
+// the band edges keep the false-alarm rate. For exponential noise,
+// CA: Pfa = (1 + alpha/n)^-n; OS with rank k: Pfa = prod_{i<k} (n-i)/(n-i+alpha)
+void setup_cfar(void) {
+    cfar_ca_alpha[0] = cfar_os_alpha[0] = HUGE_VAL;
+    for (int n = 1; n <= 2 * CFAR_TRAINING_CELLS; ++n) {
+        cfar_ca_alpha[n] = n * (pow(CFAR_PFA, -1.0 / n) - 1.0);
+        int k = cfar_rank(n) + 1;
+        double lo = 0.0;
+        double hi = 1e9;
+        for (int iter = 0; iter < 200; ++iter) {
+            double mid = 0.5 * (lo + hi);
+            double log_pfa = 0.0;
+            for (int i = 0; i < k; ++i) {
+                log_pfa += log((n - i) / (n - i + mid));
+            }
+            if (log_pfa > log(CFAR_PFA)) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        cfar_os_alpha[n] = hi;
+        // E[X(k)] / mean for exponential noise is H(n) - H(n - k)
+        cfar_os_mean[n] = 0.0;
+        for (int i = 0; i < k; ++i) {
+            cfar_os_mean[n] += 1.0 / (n - i);
+        }
+    }
+    setup_block_cfar();
+}
+
+// Threshold factors for block-mean spectra. With L = INTEGRATION_FRAMES a
+// noise bin is gamma(L) distributed; for CA the training mean over n cells
+// is gamma(nL), so with c = alpha/n and M = nL
+// Pfa = sum_{i<L} C(M+i-1, i) c^i (1+c)^-(M+i). OS has no closed form: the
+// false-alarm rate is the gamma(L) tail at alpha x averaged over the
+// density of the rank-k statistic, integrated numerically.
+void setup_block_cfar(void) {
+    const int looks = INTEGRATION_FRAMES;
+    const double x_max = 4.0 * looks + 40.0;
+    const double step = x_max / CFAR_BLOCK_STEPS;
+    static double weight[CFAR_BLOCK_STEPS + 1];
+    cfar_block_ca_alpha[0] = cfar_block_os_alpha[0] = HUGE_VAL;
+    for (int n = 1; n <= 2 * CFAR_TRAINING_CELLS; ++n) {
+        int m = n * looks;
+        double lo = 0.0;
+        double hi = 1e3;
+        for (int iter = 0; iter < 100; ++iter) {
+            double mid = 0.5 * (lo + hi);
+            double c = mid / n;
+            double term = exp(-m * log1p(c));
+            double pfa = 0.0;
+            for (int i = 0; i < looks; ++i) {
+                pfa += term;
+                term *= (double)(m + i) / (i + 1) * c / (1.0 + c);
+            }
+            if (pfa > CFAR_PFA) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        cfar_block_ca_alpha[n] = hi;
+
+        // Simpson weights times the rank-k density of n gamma(L) cells
+        int k = cfar_rank(n) + 1;
+        double log_norm = lgamma(n + 1.0) - lgamma(k) - lgamma(n - k + 1.0) - lgamma(looks);
+        double mean = 0.0;
+        for (int j = 0; j <= CFAR_BLOCK_STEPS; ++j) {
+            double x = j * step;
+            double below = gamma_cdf(looks, x);
+            double above = 1.0 - below;
+            weight[j] = 0.0;
+            if (below > 0.0 && above > 0.0) {
+                double simpson = (j == 0 || j == CFAR_BLOCK_STEPS) ? 1.0 : (j % 2 ? 4.0 : 2.0);
+                weight[j] = simpson * step / 3.0 *
+                            exp(log_norm + (k - 1) * log(below) + (n - k) * log(above) + (looks - 1) * log(x) - x);
+            }
+            mean += weight[j] * x;
+        }
+        cfar_block_os_mean[n] = mean / looks;
+        lo = 0.0;
+        hi = 1e3;
+        for (int iter = 0; iter < 60; ++iter) {
+            double mid = 0.5 * (lo + hi);
+            double pfa = 0.0;
+            for (int j = 0; j <= CFAR_BLOCK_STEPS; ++j) {
+                if (weight[j] > 0.0) {
+                    pfa += weight[j] * gamma_tail(looks, mid * j * step);
+                }
+            }
+            if (pfa > CFAR_PFA) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        cfar_block_os_alpha[n] = hi;
+    }
+}
+
+// P(X > x) for a unit-scale gamma variable of integer shape
+double gamma_tail(int shape, double x) {
+    double term = 1.0;
+    double series = 0.0;
+    for (int i = 0; i < shape; ++i) {
+        series += term;
+        term *= x / (i + 1);
+    }
+    return exp(-x) * series;
+}
+
+// P(X <= x) for the same; below the mode the series keeps its precision
+double gamma_cdf(int shape, double x) {
+    if (x <= 0.0) {
+        return 0.0;
+    }
+    if (x > shape + 1.0) {
+        return 1.0 - gamma_tail(shape, x);
+    }
+    double term = exp(shape * log(x) - x - lgamma(shape + 1.0));
+    double series = 0.0;
+    for (int i = shape + 1; term > series * 1e-17; ++i) {
+        series += term;
+        term *= x / i;
+    }
+    return series;
+}
+
+// Zero-based rank of the ordered statistic among n training cells
+int cfar_rank(int n) {
+    return (3 * n + 3) / 4 - 1;
+}
+
+// k-th smallest of values[0..n-1] (reorders the array)
+double select_kth(double* values, int n, int k) {
+    int lo = 0;
+    int hi = n - 1;
+    while (lo < hi) {
+        double pivot = values[(lo + hi) / 2];
+        int i = lo;
+        int j = hi;
+        while (i <= j) {
+            while (values[i] < pivot) i++;
+            while (values[j] > pivot) j--;
+            if (i <= j) {
+                double tmp = values[i];
+                values[i++] = values[j];
+                values[j--] = tmp;
+            }
+        }
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            break;
+        }
+    }
+    return values[k];
+}
+
+// Noise statistic of the current CFAR detector around a peak at bin: the
+// mean (CA) or ordered statistic (OS) of the training cells, which sit
+// beyond suppress_bins guard cells on either side and are clipped to the
+// pass band. Squelched cells are skipped; if all are, the squelch level
+// stands in for the noise mean. *cells receives the number used; with none
+// in the band it returns 0.
+double cfar_statistic(const double* powers, int bin, int* cells) {
+    int left_hi = bin - suppress_bins - 1;
+    int left_lo = bin - suppress_bins - CFAR_TRAINING_CELLS;
+    int right_lo = bin + suppress_bins + 1;
+    int right_hi = bin + suppress_bins + CFAR_TRAINING_CELLS;
+    if (left_lo < detect_lo) left_lo = detect_lo;
+    if (right_hi > detect_hi) right_hi = detect_hi;
+    int left = left_hi >= left_lo ? left_hi - left_lo + 1 : 0;
+    int right = right_hi >= right_lo ? right_hi - right_lo + 1 : 0;
+    int n = left + right;
+    *cells = n;
+    if (n == 0) {
+        return 0.0;
+    }
+    bool block = integration_mode != INTEGRATION_OFF;
+    if (detector_mode == DETECTOR_CA_CFAR) {
+        double sum = 0.0;
+        int live = 0;
+        if (left > 0) {
+            sum += cfar_prefix[left_hi + 1] - cfar_prefix[left_lo];
+            live += cfar_live[left_hi + 1] - cfar_live[left_lo];
+        }
+        if (right > 0) {
+            sum += cfar_prefix[right_hi + 1] - cfar_prefix[right_lo];
+            live += cfar_live[right_hi + 1] - cfar_live[right_lo];
+        }
+        if (live == 0) {
+            return squelch_power();
+        }
+        *cells = live;
+        return sum / live;
+    }
+    double training[2 * CFAR_TRAINING_CELLS];
+    int live = 0;
+    for (int i = left_lo; i < left_lo + left; ++i) {
+        if (powers[i] > 0.0) training[live++] = powers[i];
+    }
+    for (int i = right_lo; i < right_lo + right; ++i) {
+        if (powers[i] > 0.0) training[live++] = powers[i];
+    }
+    if (live == 0) {
+        return squelch_power() * (block ? cfar_block_os_mean[n] : cfar_os_mean[n]);
+    }
+    *cells = live;
+    return select_kth(training, live, cfar_rank(live));
+}
+
+// Power a peak at bin must exceed under the current CFAR detector; with no
+// training cells left the peak cannot be judged
+double cfar_threshold(const double* powers, int bin) {
+    int n;
+    double statistic = cfar_statistic(powers, bin, &n);
+    if (n == 0) {
+        return HUGE_VAL;
+    }
+    bool block = integration_mode != INTEGRATION_OFF;
+    double* alpha = detector_mode == DETECTOR_CA_CFAR ? (block ? cfar_block_ca_alpha : cfar_ca_alpha)
+                                                      : (block ? cfar_block_os_alpha : cfar_os_alpha);
+    return alpha[n] * statistic;
+}
+
+// Noise power per bin around a peak as the active detector estimates it:
+// the local floor, or the CFAR training cells rescaled to their mean
+double peak_noise(const double* powers, const SpectralPeak* peak) {
+    if (detector_mode == DETECTOR_LOCAL_SNR) {
+        return noise_floor[peak->bin];
+    }
+    int n;
+    double statistic = cfar_statistic(powers, peak->bin, &n);
+    if (n == 0) {
+        return 0.0;
+    }
+    if (detector_mode == DETECTOR_CA_CFAR) {
+        return statistic;
+    }
+    return statistic / (integration_mode != INTEGRATION_OFF ? cfar_block_os_mean[n] : cfar_os_mean[n]);
+}
+
+// Amplitude and SNR of a detected peak from its bins. The main-lobe power,
+// less the noise under the lobe, divided by the estimator's ENBW is the
+// scalloping-free peak power; the spectra are scaled so a full-scale sine
+// peaks at (FFT_SIZE/4)^2 with any window, which corrects the coherent gain.
+// An AGC gain is taken back out so the level describes the input.
+void peak_level(const double* powers, const SpectralPeak* peak, double* level_db, double* snr_db) {
+    double noise = peak_noise(powers, peak);
+    double signal = fmax(peak->power - (2 * peak_halfwidth + 1) * noise, peak->bin_power * 1e-3);
+    double amplitude = sqrt(signal / lobe_enbw) / (FFT_SIZE / 4.0);
+    double agc_db = agc_enabled ? frame_gain_db : 0.0;
+    *level_db = amplitude > 0.0 ? 20.0 * log10(amplitude) - agc_db : SILENCE_GATE_MIN_DB;
+    *snr_db = noise > 0.0 ? 10.0 * log10(peak->bin_power / noise) : HUGE_VAL;
+}
+
+// Whether a peak passes the selected detector
+bool peak_detected(const double* powers, const SpectralPeak* peak) {
+    if (detector_mode == DETECTOR_LOCAL_SNR) {
+        double threshold = integration_mode != INTEGRATION_OFF ? integration_snr : pow(10.0, DETECT_SNR_DB / 10.0);
+        return peak_snr(peak) > threshold;
+    }
+    return peak->bin_power > cfar_threshold(powers, peak->bin);
+}
+
+// Bins the peak search covers this frame: the whole spectrum on an
+// acquisition scan, otherwise the merged windows around the live tracks.
+// Each window is the track's association gate around its prediction, and
+// for a tone with harmonics also the harmonic tolerance (and gate, scaled)
+// around each multiple, widened by the suppression radius so a peak at the
+// window edge is compared with the same neighbours as in a full scan.
+int search_ranges(double total_power, BinRange* ranges) {
+    int n = FFT_SIZE / 2;
+    bool scan = !tracked_search || integration_mode != INTEGRATION_OFF || ++frames_since_scan >= ACQUISITION_INTERVAL ||
+                scan_power <= 0.0 || total_power <= 0.0 ||
+                fabs(10.0 * log10(total_power / scan_power)) > ACQUISITION_ENERGY_DB;
+    int count = 0;
+    if (!scan) {
+        double gate[MAX_TRACKED_SINES];
+        track_gates(gate);
+        for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+            if (tracks.start_time[i] == 0) {
+                continue;
+            }
+            int harmonics = tracks.harmonics[i] > 0 ? MAX_HARMONIC : 1;
+            for (int h = 1; h <= harmonics; ++h) {
+                double tolerance = h * gate[i] + (h > 1 ? (HARMONIC_TOLERANCE_BINS + 0.1 * h) * freq_resolution : 0.0);
+                ranges[count].lo = (int)floor((h * tracks.predicted[i] - tolerance) / freq_resolution);
+                ranges[count].hi = (int)ceil((h * tracks.predicted[i] + tolerance) / freq_resolution);
+                count++;
+            }
+        }
+        scan = count == 0;
+    }
+    if (scan) {
+        if (tracked_search) {
+            frames_since_scan = 0;
+            scan_power = total_power;
+            full_scans++;
+        }
+        ranges[0] = (BinRange){1, n - 2};
+        return 1;
+    }
+    count = merge_ranges(ranges, count, suppress_bins, 1, n - 2);
+    tracked_frames++;
+    for (int r = 0; r < count; ++r) {
+        tracked_bins += ranges[r].hi - ranges[r].lo + 1;
+    }
+    return count;
+}
+
+// Widen each range by widen bins, clip it to lo..hi, and merge overlapping
+// or touching ranges into ascending order in place. Returns the new count.
+int merge_ranges(BinRange* ranges, int count, int widen, int lo, int hi) {
+    int kept = 0;
+    for (int r = 0; r < count; ++r) {
+        BinRange range = {ranges[r].lo - widen, ranges[r].hi + widen};
+        if (range.lo < lo) range.lo = lo;
+        if (range.hi > hi) range.hi = hi;
+        if (range.lo > range.hi) {
+            continue;
+        }
+        // Insertion sort by start; there are at most MAX_SEARCH_RANGES
+        int pos = kept++;
+        while (pos > 0 && ranges[pos - 1].lo > range.lo) {
+            ranges[pos] = ranges[pos - 1];
+            pos--;
+        }
+        ranges[pos] = range;
+    }
+    int merged = 0;
+    for (int r = 0; r < kept; ++r) {
+        if (merged > 0 && ranges[r].lo <= ranges[merged - 1].hi + 1) {
+            if (ranges[r].hi > ranges[merged - 1].hi) {
+                ranges[merged - 1].hi = ranges[r].hi;
+            }
+        } else {
+            ranges[merged++] = ranges[r];
+        }
+    }
+    return merged;
+}
+
+// Collect up to max_peaks local maxima above min_power in descending power
+// order in one pass over the given ascending bin ranges, which must lie
+// within 1..N/2-2. A maximum within suppress_bins of a stronger accepted one
+// is dropped, and a stronger one evicts the weaker ones it reaches. This
+// approximates picking the strongest remaining peak max_peaks times, but is
+// not the same: an entry that is later evicted has already dropped or evicted
+// maxima beyond its evictor's reach, which strongest-first picking would keep.
+// A run of rising maxima, each within suppress_bins of the next, keeps only
+// its top where strongest-first picking would keep every other one.
+// Further out, a maximum SIDELOBE_REJECT_DB below a stronger one is taken
+// to be its window sidelobe, which the local noise floor does not cover.
+int find_peaks(const MaxPyramid* pyramid, const BinRange* ranges, int range_count, double min_power, SpectralPeak* peaks,
+               int max_peaks) {
+    const double* powers = pyramid->values;
+    int count = 0;
+    int sidelobe_bins = SIDELOBE_RADIUS_FACTOR * suppress_bins;
+    double sidelobe_ratio = pow(10.0, -SIDELOBE_REJECT_DB / 10.0);
+    for (int r = 0; r < range_count; ++r) {
+        for (int i = ranges[r].lo; i <= ranges[r].hi; ++i) {
+            // Only bins above min_power, and once the list is full above its
+            // weakest entry, can be taken; the pyramid skips to the next one
+            double threshold = count == max_peaks ? fmax(min_power, peaks[count - 1].bin_power) : min_power;
+            i = pyramid_next_above(pyramid, i, ranges[r].hi, threshold);
+            if (i > ranges[r].hi) {
+                break;
+            }
+            double power = powers[i];
+            if (!(power > min_power && power > powers[i - 1] && power >= powers[i + 1])) {
+                continue;
+            }
+            if (count == max_peaks && power <= peaks[count - 1].bin_power) {
+                continue;
+            }
+            bool suppressed = false;
+            for (int j = 0; j < count; ++j) {
+                int distance = abs(peaks[j].bin - i);
+                double weaker = fmin(peaks[j].bin_power, power);
+                double stronger = fmax(peaks[j].bin_power, power);
+                if (distance > suppress_bins &&
+                    (distance > sidelobe_bins || weaker >= stronger * sidelobe_ratio)) {
+                    continue;
+                }
+                if (peaks[j].bin_power >= power) {
+                    suppressed = true;
+                    break;
+                }
+                memmove(&peaks[j], &peaks[j + 1], sizeof(SpectralPeak) * (count - j - 1));
+                count--;
+                j--;
+            }
+            if (suppressed) {
+                continue;
+            }
+            int pos = count < max_peaks ? count++ : max_peaks - 1;
+            while (pos > 0 && peaks[pos - 1].bin_power < power) {
+                peaks[pos] = peaks[pos - 1];
+                pos--;
+            }
+            peaks[pos].bin = i;
+            peaks[pos].bin_power = power;
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        measure_peak(powers, &peaks[i]);
+    }
+    return count;
+}
+
+// Fill in a peak's main-lobe power and its bin-centre and interpolated
+// frequencies from the peak bin
+void measure_peak(const double* powers, SpectralPeak* peak) {
+    int bin = peak->bin;
+    peak->bin_power = powers[bin];
+    peak->power = 0.0;
+    for (int k = bin - peak_halfwidth; k <= bin + peak_halfwidth; ++k) {
+        if (k >= 0 && k < FFT_SIZE / 2) {
+            peak->power += powers[k];
+        }
+    }
+    peak->freq = bin * freq_resolution;
+    double offset;
+    if (padded_ready) {
+        offset = padded_offset(bin);
+    } else if (spectral_mode == SPECTRUM_PERIODOGRAM) {
+        offset = lobe_offset(powers, bin, peak_halfwidth, centroid_interpolation);
+        // Undo the interpolator's bias for the active window
+        const double* bias = window_info[window_type].bias;
+        double pos = (fmin(fmax(offset, -0.5), 0.5) + 0.5) * (WINDOW_BIAS_POINTS - 1);
+        int j = (int)pos;
+        if (j >= WINDOW_BIAS_POINTS - 1) j = WINDOW_BIAS_POINTS - 2;
+        offset = bias[j] + (pos - j) * (bias[j + 1] - bias[j]);
+    } else {
+        offset = lobe_offset(powers, bin, peak_halfwidth, centroid_interpolation);
+    }
+    peak->interp_freq = (bin + offset) * freq_resolution;
+}
+
+// Fractional offset of a peak from its bin: the power centroid of the lobe
+// for broad, flat-topped lobes, otherwise a parabola through the log power
+// of the peak and its neighbours
+double lobe_offset(const double* powers, int bin, int halfwidth, bool centroid) {
+    if (centroid) {
+        double total = 0.0;
+        double weighted = 0.0;
+        for (int k = bin - halfwidth; k <= bin + halfwidth; ++k) {
+            if (k >= 0 && k < FFT_SIZE / 2) {
+                total += powers[k];
+                weighted += (k - bin) * powers[k];
+            }
+        }
+        return total > 0.0 ? weighted / total : 0.0;
+    }
+    double left = powers[bin - 1];
+    double centre = powers[bin];
+    double right = powers[bin + 1];
+    if (left > 0.0 && right > 0.0 && centre > 0.0) {
+        double a = log(left), b = log(centre), c = log(right);
+        double denom = a - 2.0 * b + c;
+        if (denom < 0.0) {
+            return 0.5 * (a - c) / denom;
+        }
+    }
+    return 0.0;
+}
+
+int compare_peak_freq(const void* a, const void* b) {
+    double fa = ((const SpectralPeak*)a)->interp_freq;
+    double fb = ((const SpectralPeak*)b)->interp_freq;
+    return (fa > fb) - (fa < fb);
+}
+
+// Assign peaks lying at integer multiples of a lower, stronger peak to it.
+// Peaks are sorted by frequency and each harmonic is located by binary
+// search, so grouping costs O(K log K) for K candidates. The peak array is
+// left in ascending frequency order; rank still records the power order.
+void group_harmonics(SpectralPeak* peaks, int count) {
+    for (int i = 0; i < count; ++i) {
+        peaks[i].rank = i;
+        peaks[i].fundamental = -1;
+        peaks[i].harmonics = 0;
+        peaks[i].group_power = peaks[i].power;
+    }
+    qsort(peaks, count, sizeof(SpectralPeak), compare_peak_freq);
+
+    for (int i = 0; i < count; ++i) {
+        if (peaks[i].fundamental != -1 || peaks[i].bin < HARMONIC_MIN_BIN) {
+            continue;
+        }
+        double f0 = peaks[i].interp_freq;
+        for (int h = 2; h <= MAX_HARMONIC; ++h) {
+            double target = h * f0;
+            double tolerance = (HARMONIC_TOLERANCE_BINS + 0.1 * h) * freq_resolution;
+            if (target - tolerance > peaks[count - 1].interp_freq) {
+                break;
+            }
+            // First peak at or above the target, then pick the nearer neighbour
+            int lo = i + 1, hi = count;
+            while (lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (peaks[mid].interp_freq < target) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            int j = lo;
+            if (j > i + 1 && (j == count || target - peaks[j - 1].interp_freq < peaks[j].interp_freq - target)) {
+                j--;
+            }
+            if (j >= count || fabs(peaks[j].interp_freq - target) > tolerance) {
+                continue;
+            }
+            if (peaks[j].fundamental != -1 || peaks[j].bin_power >= peaks[i].bin_power) {
+                continue;
+            }
+            peaks[j].fundamental = i;
+            peaks[i].harmonics++;
+            peaks[i].group_power += peaks[j].power;
+        }
+    }
+}
+
+// --- Max Pyramid ---
+// Build all levels over values[0..n-1]; n may not exceed FFT_SIZE / 2
+void build_max_pyramid(MaxPyramid* p, const double* values, int n) {
+    p->values = values;
+    p->n = n;
+    p->levels = 0;
+    const double* below = values;
+    int below_n = n;
+    int offset = 0;
+    while (below_n > 1 && p->levels < PYRAMID_MAX_LEVELS) {
+        int size = (below_n + PYRAMID_FANOUT - 1) / PYRAMID_FANOUT;
+        double* level = p->blocks + offset;
+        for (int b = 0; b < size; ++b) {
+            int end = b * PYRAMID_FANOUT + PYRAMID_FANOUT < below_n ? b * PYRAMID_FANOUT + PYRAMID_FANOUT : below_n;
+            double m = below[b * PYRAMID_FANOUT];
+            for (int k = b * PYRAMID_FANOUT + 1; k < end; ++k) {
+                m = below[k] > m ? below[k] : m;
+            }
+            level[b] = m;
+        }
+        p->offset[p->levels++] = offset;
+        offset += size;
+        below = level;
+        below_n = size;
+    }
+}
+
+// First index from i to hi whose value is above threshold, or hi + 1. A bin
+// at or below it is passed over together with the largest enclosing block
+// that is also at or below it, so the walk only descends into blocks that
+// hold a qualifying bin.
+int pyramid_next_above(const MaxPyramid* p, int i, int hi, double threshold) {
+    while (i <= hi) {
+        if (p->values[i] > threshold) {
+            return i;
+        }
+        int next = i + 1;
+        int span = 1;
+        for (int l = 0; l < p->levels; ++l) {
+            span *= PYRAMID_FANOUT;
+            int b = i / span;
+            if (p->blocks[p->offset[l] + b] > threshold) {
+                break;
+            }
+            next = (b + 1) * span;
+        }
+        i = next;
+    }
+    return hi + 1;
+}
+
+// Maximum of the values from lo to hi, from the largest aligned blocks
+// that fit inside the range
+double pyramid_max(const MaxPyramid* p, int lo, int hi) {
+    double m = -HUGE_VAL;
+    while (lo <= hi) {
+        int level = -1;
+        int span = 1;
+        while (level + 1 < p->levels && lo % (span * PYRAMID_FANOUT) == 0 && lo + span * PYRAMID_FANOUT - 1 <= hi) {
+            span *= PYRAMID_FANOUT;
+            level++;
+        }
+        double v = level < 0 ? p->values[lo] : p->blocks[p->offset[level] + lo / span];
+        m = v > m ? v : m;
+        lo += span;
+    }
+    return m;
+}
+
+// --- DTMF Decoder ---
+void dtmf_init(void) {
+    for (int k = 0; k < 8; ++k) {
+        dtmf_coeff[k] = 2.0 * cos(2.0 * M_PI * dtmf_freqs[k] / SAMPLE_RATE);
+    }
+    memset(&dtmf, 0, sizeof(dtmf));
+}
+
+// Run the 8-frequency Goertzel bank over a block of samples, classifying each
+// completed frame. The state carries across calls so frames need not align
+// with audio chunks; one decoder per channel is all that is required.
+void dtmf_process(DtmfDecoder* d, const Sint16* samples, int count, double gain) {
+    double scale = gain / MAX_AMPLITUDE;
+    for (int i = 0; i < count; ++i) {
+        double x = samples[i] * scale;
+        d->energy += x * x;
+        for (int k = 0; k < 8; ++k) {
+            double s0 = x + dtmf_coeff[k] * d->s1[k] - d->s2[k];
+            d->s2[k] = d->s1[k];
+            d->s1[k] = s0;
+        }
+        if (++d->count < DTMF_FRAME_SIZE) {
+            continue;
+        }
+        // Report a digit once it is seen in two consecutive frames
+        char digit = dtmf_classify(d);
+        if (digit == d->last && digit != d->held) {
+            d->held = digit;
+            if (digit && dtmf_pending_count < DTMF_MAX_PENDING) {
+                dtmf_pending[dtmf_pending_count++] = digit;
+            }
+        }
+        d->last = digit;
+        memset(d->s1, 0, sizeof(d->s1));
+        memset(d->s2, 0, sizeof(d->s2));
+        d->energy = 0.0;
+        d->count = 0;
+    }
+}
+
+// Decide which digit, if any, a completed frame holds. Each group's strongest
+// tone must clear the level floor and dominate its group, the pair must hold
+// most of the frame energy, and the level difference must be within twist.
+char dtmf_classify(const DtmfDecoder* d) {
+    double power[8];
+    for (int k = 0; k < 8; ++k) {
+        power[k] = d->s1[k] * d->s1[k] + d->s2[k] * d->s2[k] - dtmf_coeff[k] * d->s1[k] * d->s2[k];
+    }
+    int row = 0, col = 4;
+    for (int k = 1; k < 4; ++k) {
+        if (power[k] > power[row]) row = k;
+        if (power[k + 4] > power[col]) col = k + 4;
+    }
+    // A tone of amplitude A gives Goertzel power (A * N / 2)^2
+    double min_power = DTMF_MIN_LEVEL * DTMF_FRAME_SIZE / 2.0;
+    min_power *= min_power;
+    if (power[row] < min_power || power[col] < min_power) {
+        return 0;
+    }
+    // ...and contributes A^2 * N / 2 to the frame energy
+    double tone_energy = 2.0 * (power[row] + power[col]) / DTMF_FRAME_SIZE;
+    if (tone_energy < DTMF_ENERGY_RATIO * d->energy) {
+        return 0;
+    }
+    for (int k = 0; k < 4; ++k) {
+        if ((k != row && power[k] * DTMF_RELATIVE_PEAK > power[row]) ||
+            (k + 4 != col && power[k + 4] * DTMF_RELATIVE_PEAK > power[col])) {
+            return 0;
+        }
+    }
+    double twist_db = 10.0 * log10(power[col] / power[row]);
+    if (twist_db < -DTMF_NORMAL_TWIST_DB || twist_db > DTMF_REVERSE_TWIST_DB) {
+        return 0;
+    }
+    return dtmf_keys[row][col - 4];
+}
+
+// --- Frequency Counter ---
+// Count zero crossings over a chunk and report the window's frequency once
+// it is long enough. Windows carry across chunks, so tones with periods
+// longer than a chunk are still counted; a window whose last crossing is
+// older than the lowest band frequency allows is abandoned.
+void counter_process(FreqCounter* c, const Sint16* samples, int count, double gain, Uint32 now) {
+    double scale = gain / MAX_AMPLITUDE;
+    double r = 1.0 - 2.0 * M_PI * COUNTER_DC_HZ / SAMPLE_RATE;
+    double chunk_peak = 0.0;
+    for (int i = 0; i < count; ++i) {
+        double x = samples[i] * scale;
+        double y = x - c->x1 + r * c->y1;
+        c->x1 = x;
+        c->y1 = y;
+        chunk_peak = fmax(chunk_peak, fabs(y));
+        if (y < -c->threshold) {
+            c->armed = true;
+        } else if (c->armed) {
+            if (c->prev < 0.0 && y >= 0.0) {
+                c->crossing = (double)c->position - 1.0 + c->prev / (c->prev - y);
+            }
+            if (y > c->threshold) {
+                // Schmitt trigger: the last zero crossing on the way up counts
+                double t = c->crossing;
+                c->armed = false;
+                if (c->started) {
+                    double period = t - c->last;
+                    c->period_sum += period;
+                    c->period_sq += period * period;
+                    c->cycles++;
+                } else {
+                    c->started = true;
+                    c->first = t;
+                    c->cycles = 0;
+                    c->period_sum = c->period_sq = 0.0;
+                    c->energy = 0.0;
+                    c->energy_count = 0;
+                }
+                c->last = t;
+            }
+        }
+        if (c->started) {
+            c->energy += y * y;
+            c->energy_count++;
+        }
+        c->prev = y;
+        c->position++;
+    }
+    c->threshold = COUNTER_HYSTERESIS * fmax(chunk_peak, COUNTER_MIN_LEVEL);
+    if (!c->started) {
+        return;
+    }
+    if ((double)c->position - c->last > (double)SAMPLE_RATE / SINE_WAVE_MIN_HZ) {
+        c->started = false;
+        return;
+    }
+    double span = c->last - c->first;
+    if (c->cycles < COUNTER_MIN_CYCLES || span < COUNTER_WINDOW_MS * SAMPLE_RATE / 1000.0) {
+        return;
+    }
+    double mean = c->period_sum / c->cycles;
+    double spread = sqrt(fmax(c->period_sq / c->cycles - mean * mean, 0.0));
+    double rms = sqrt(c->energy / c->energy_count);
+    double freq = c->cycles * (double)SAMPLE_RATE / span;
+    // Start the next window at the latest crossing
+    c->first = c->last;
+    c->cycles = 0;
+    c->period_sum = c->period_sq = 0.0;
+    c->energy = 0.0;
+    c->energy_count = 0;
+    if (spread > COUNTER_MAX_JITTER * mean || sqrt(2.0) * rms < COUNTER_MIN_LEVEL ||
+        freq < bandpass_low_hz || freq > bandpass_high_hz) {
+        return;
+    }
+    double snr = spread > 0.0 ? 1.0 / pow(2.0 * M_PI * spread / mean, 2.0) : HUGE_VAL;
+    double level_db = 20.0 * log10(sqrt(2.0) * rms) - (agc_enabled ? chunk_gain_db : 0.0);
+    double snr_db = isinf(snr) ? HUGE_VAL : 10.0 * log10(snr);
+    update_track(freq, isinf(snr) ? 1.0 : snr / (1.0 + snr), 0, level_db, snr_db, now);
+}
+
+// --- Track Demodulators ---
+// Kaiser-windowed sinc cut off half way to the output rate, so the passband
+// and the band that aliases onto it sit either side of the transition
+void setup_demod(void) {
+    double cutoff = 0.5 / DEMOD_DECIMATION;
+    double sum = 0.0;
+    for (int t = 0; t < DEMOD_TAPS; ++t) {
+        double m = t - (DEMOD_TAPS - 1) / 2.0;
+        double r = m / ((DEMOD_TAPS - 1) / 2.0);
+        double window = bessel_i0(DEMOD_KAISER_BETA * sqrt(fmax(0.0, 1.0 - r * r))) / bessel_i0(DEMOD_KAISER_BETA);
+        demod_prototype[t] = 2.0 * cutoff * (m == 0.0 ? 1.0 : sin(2.0 * M_PI * cutoff * m) / (2.0 * M_PI * cutoff * m)) * window;
+        sum += demod_prototype[t];
+    }
+    for (int t = 0; t < DEMOD_TAPS; ++t) {
+        demod_prototype[t] /= sum;
+    }
+    memset(demod_input, 0, sizeof(demod_input));
+    demod_next = 0;
+}
+
+// Run the demodulator of every active track over a prefiltered chunk and
+// release the ones whose track has gone
+void demodulate_tracks(const double* samples) {
+    if (!demod_enabled) {
+        for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+            demods[i].start_time = 0;
+        }
+        return;
+    }
+    memcpy(demod_input + DEMOD_TAPS - 1, samples, sizeof(double) * CHUNK_SIZE);
+    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+        TrackDemod* d = &demods[i];
+        if (!tracks.active[i]) {
+            d->start_time = 0;
+            continue;
+        }
+        bool restart = d->start_time != tracks.start_time[i] || fabs(tracks.freq[i] - d->mix_hz) > DEMOD_RETUNE_HZ;
+        if (restart) {
+            bool same_track = d->start_time == tracks.start_time[i];
+            int dropouts = same_track ? d->dropouts : 0;
+            double last_dropout_ms = same_track ? d->last_dropout_ms : 0.0;
+            memset(d, 0, sizeof(*d));
+            d->start_time = tracks.start_time[i];
+            d->mix_hz = tracks.freq[i];
+            d->settle = DEMOD_SETTLE;
+            d->dropouts = dropouts;
+            d->last_dropout_ms = last_dropout_ms;
+            retune_demod(d);
+        }
+        // Suspend the measurements while another tone is close enough to
+        // beat with this one; they restart, dropout count kept, once clear
+        d->crowded = demod_crowded(i, d->mix_hz);
+        if (d->crowded) {
+            d->count = 0;
+            d->envelope = 0.0;
+            d->in_dropout = false;
+            d->settle = DEMOD_SETTLE;
+            continue;
+        }
+        demodulate_track(d, demod_next);
+    }
+    int kept = (CHUNK_SIZE - demod_next + DEMOD_DECIMATION - 1) / DEMOD_DECIMATION;
+    demod_next += kept * DEMOD_DECIMATION - CHUNK_SIZE;
+    memmove(demod_input, demod_input + CHUNK_SIZE, sizeof(double) * (DEMOD_TAPS - 1));
+}
+
+// Whether another track, or the mirror image of any track (itself
+// included), lies within DEMOD_STOP_HZ of an oscillator at mix_hz
+bool demod_crowded(int track, double mix_hz) {
+    for (int j = 0; j < MAX_TRACKED_SINES; ++j) {
+        if (!tracks.active[j]) {
+            continue;
+        }
+        if ((j != track && fabs(tracks.freq[j] - mix_hz) < DEMOD_STOP_HZ) || tracks.freq[j] + mix_hz < DEMOD_STOP_HZ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Modulate the prototype to the mixing frequency: tap t weights the sample
+// t after the window's oldest by exp(-i w t), and the oscillator supplies
+// exp(-i w n) for that oldest sample n
+void retune_demod(TrackDemod* d) {
+    double step = 2.0 * M_PI * d->mix_hz / SAMPLE_RATE;
+    for (int t = 0; t < DEMOD_TAPS; ++t) {
+        d->taps_re[t] = demod_prototype[t] * cos(step * t);
+        d->taps_im[t] = -demod_prototype[t] * sin(step * t);
+    }
+}
+
+// Compute the kept outputs of one chunk for one track, starting with the
+// one whose newest input is chunk sample first, and measure them
+void demodulate_track(TrackDemod* d, int first) {
+    double i_buf[CHUNK_SIZE / DEMOD_DECIMATION + 1], q_buf[CHUNK_SIZE / DEMOD_DECIMATION + 1];
+    double advance = d->mix_hz * DEMOD_DECIMATION / SAMPLE_RATE;
+    int count = 0;
+    for (int n = first; n < CHUNK_SIZE; n += DEMOD_DECIMATION) {
+        const double* window = demod_input + n;
+        // Four partial sums each, so the adds do not wait on one another
+        double re[4] = {0.0, 0.0, 0.0, 0.0}, im[4] = {0.0, 0.0, 0.0, 0.0};
+        for (int t = 0; t < DEMOD_TAPS; t += 4) {
+            for (int j = 0; j < 4; ++j) {
+                re[j] += d->taps_re[t + j] * window[t + j];
+                im[j] += d->taps_im[t + j] * window[t + j];
+            }
+        }
+        double sum_re = (re[0] + re[1]) + (re[2] + re[3]);
+        double sum_im = (im[0] + im[1]) + (im[2] + im[3]);
+        double rot_re = cos(2.0 * M_PI * d->phase), rot_im = -sin(2.0 * M_PI * d->phase);
+        i_buf[count] = sum_re * rot_re - sum_im * rot_im;
+        q_buf[count] = sum_re * rot_im + sum_im * rot_re;
+        count++;
+        d->phase = fmod(d->phase + advance, 1.0);
+    }
+
+    double rate = (double)SAMPLE_RATE / DEMOD_DECIMATION;
+    double alpha = 1.0 - exp(-1000.0 / (DEMOD_ENVELOPE_MS * rate));
+    double drop = pow(10.0, -DEMOD_DROPOUT_DB / 20.0);
+    double recover = pow(10.0, -DEMOD_RECOVER_DB / 20.0);
+    int min_dropout = (int)ceil(DEMOD_DROPOUT_MIN_MS * rate / 1000.0);
+    for (int k = 0; k < count; ++k) {
+        double zi = i_buf[k], zq = q_buf[k];
+        double prev_i = d->prev_i, prev_q = d->prev_q;
+        d->prev_i = zi;
+        d->prev_q = zq;
+        if (d->settle > 0) {
+            d->settle--;
+            continue;
+        }
+        // Phase step from z[k] * conj(z[k-1]), which needs no unwrapping
+        double step_phase = atan2(zq * prev_i - zi * prev_q, zi * prev_i + zq * prev_q);
+        double amplitude = 2.0 * sqrt(zi * zi + zq * zq);
+        d->freq[d->head] = d->mix_hz + step_phase * rate / (2.0 * M_PI);
+        d->amplitude[d->head] = amplitude;
+        d->head = (d->head + 1) % DEMOD_HISTORY;
+        d->count = d->count < DEMOD_HISTORY ? d->count + 1 : DEMOD_HISTORY;
+        if (d->envelope == 0.0) {
+            d->envelope = amplitude;
+        }
+        if (d->in_dropout) {
+            d->dropout_samples++;
+            if (amplitude >= recover * d->envelope) {
+                d->in_dropout = false;
+                if (d->dropout_samples >= min_dropout) {
+                    d->dropouts++;
+                    d->last_dropout_ms = 1000.0 * d->dropout_samples / rate;
+                }
+            }
+        } else if (amplitude < drop * d->envelope) {
+            d->in_dropout = true;
+            d->dropout_samples = 1;
+        } else {
+            d->envelope += alpha * (amplitude - d->envelope);
+        }
+    }
+
+    // FM deviation about the mean over the kept history
+    if (d->count > 1) {
+        double mean = 0.0;
+        for (int k = 0; k < d->count; ++k) {
+            mean += d->freq[k];
+        }
+        mean /= d->count;
+        double sq = 0.0, peak = 0.0;
+        for (int k = 0; k < d->count; ++k) {
+            double dev = d->freq[k] - mean;
+            sq += dev * dev;
+            peak = fmax(peak, fabs(dev));
+        }
+        d->fm_rms_hz = sqrt(sq / d->count);
+        d->fm_peak_hz = peak;
+    }
+}
+
+// --- Decimation ---
+// Half-band low-pass (cutoff at a quarter of the input rate): a Kaiser
+// windowed sinc whose even-offset taps vanish apart from the 0.5 centre tap.
+// At this length a Blackman window only reaches -76 dB over the alias band.
+void setup_halfband(void) {
+    double sum = 0.0;
+    for (int k = 0; k < HALFBAND_SIDE_TAPS; ++k) {
+        int m = 2 * k + 1;
+        double r = (double)m / (HALFBAND_LENGTH / 2 + 1);
+        double window = bessel_i0(HALFBAND_KAISER_BETA * sqrt(1.0 - r * r)) / bessel_i0(HALFBAND_KAISER_BETA);
+        halfband_taps[k] = sin(M_PI * m / 2.0) / (M_PI * m) * window;
+        sum += 2.0 * halfband_taps[k];
+    }
+    // Unity gain at DC
+    for (int k = 0; k < HALFBAND_SIDE_TAPS; ++k) {
+        halfband_taps[k] *= 0.5 / sum;
+    }
+}
+
+// Largest number of halving stages whose output still covers high_hz
+int decimation_stages_for(double high_hz) {
+    int stages = 0;
+    while (stages < DECIMATION_MAX_STAGES &&
+           high_hz <= DECIMATION_PASSBAND * SAMPLE_RATE / (double)(2 << stages)) {
+        stages++;
+    }
+    return stages;
+}
+
+// Switch the analysis sample rate, discarding filter state and any spectral
+// history gathered at the old rate
+void configure_decimation(int stages) {
+    decimation_stages = stages;
+    for (int s = 0; s < DECIMATION_MAX_STAGES; ++s) {
+        decimators[s].len = 0;
+    }
+    analysis_len = 0;
+    double rate = (double)SAMPLE_RATE / (1 << stages);
+    freq_resolution = rate / FFT_SIZE;
+    frame_seconds = frame_hop() / rate;
+    memset(avg_powers, 0, sizeof(avg_powers));
+    reset_integration();
+    if (polyphase.history) {
+        memset(polyphase.history, 0, sizeof(double) * POLYPHASE_TAPS * FFT_SIZE);
+    }
+}
+
+// Filter a block through one half-band stage and keep every other sample.
+// The history is split into even and odd phases first; the odd phase only
+// meets the centre tap and the symmetric even-phase taps are applied across
+// whole output blocks, so every inner loop is a contiguous, vectorisable
+// multiply-add. Returns the number of outputs written.
+int halfband_decimate(HalfbandStage* st, const double* in, int count, double* out) {
+    memcpy(st->buf + st->len, in, sizeof(double) * count);
+    st->len += count;
+    if (st->len < HALFBAND_LENGTH) {
+        return 0;
+    }
+    int n_out = (st->len - HALFBAND_LENGTH) / 2 + 1;
+    double even[(HALFBAND_LENGTH + CHUNK_SIZE + 1) / 2];
+    double odd[(HALFBAND_LENGTH + CHUNK_SIZE) / 2];
+    for (int i = 0; 2 * i < st->len; ++i) {
+        even[i] = st->buf[2 * i];
+        if (2 * i + 1 < st->len) {
+            odd[i] = st->buf[2 * i + 1];
+        }
+    }
+    const double* centre = odd + HALFBAND_SIDE_TAPS - 1;
+    for (int j = 0; j < n_out; ++j) {
+        out[j] = 0.5 * centre[j];
+    }
+    for (int k = 0; k < HALFBAND_SIDE_TAPS; ++k) {
+        double h = halfband_taps[k];
+        const double* before = even + HALFBAND_SIDE_TAPS - 1 - k;
+        const double* after = even + HALFBAND_SIDE_TAPS + k;
+        for (int j = 0; j < n_out; ++j) {
+            out[j] += h * (before[j] + after[j]);
+        }
+    }
+    st->len -= 2 * n_out;
+    memmove(st->buf, st->buf + 2 * n_out, sizeof(double) * st->len);
+    return n_out;
+}
+
+// Run a filtered chunk through the decimator cascade into the analysis
+// buffer. Returns the number of frames now complete; frame k starts
+// k * frame_hop() samples into analysis_samples.
+int gather_frames(const double* samples) {
+    double block[CHUNK_SIZE];
+    memcpy(block, samples, sizeof(block));
+    int count = CHUNK_SIZE;
+    for (int s = 0; s < decimation_stages; ++s) {
+        count = halfband_decimate(&decimators[s], block, count, block);
+    }
+    memcpy(analysis_samples + analysis_len, block, sizeof(double) * count);
+    analysis_len += count;
+    if (analysis_len < FFT_SIZE) {
+        return 0;
+    }
+    return (analysis_len - FFT_SIZE) / frame_hop() + 1;
+}
+
+// Analysis samples between frame starts. The polyphase channelizer keeps a
+// history of whole frames and the fixed-point path works on whole chunks,
+// so both always step by a full frame.
+int frame_hop(void) {
+    if (spectral_mode == SPECTRUM_POLYPHASE || fixed_path_active()) {
+        return FFT_SIZE;
+    }
+    return FFT_SIZE / frame_overlap;
+}
+
+// --- Band-pass Prefilter ---
+// Butterworth band-pass as two high-pass and two low-pass biquads
+// (bilinear transform, Q values of the 4th-order Butterworth poles)
+void design_bandpass(double low_hz, double high_hz, double rate, BiquadCoeffs* c) {
+    static const double q[2] = {0.54119610, 1.30656296};
+    for (int k = 0; k < BIQUAD_SECTIONS; ++k) {
+        bool highpass = k < 2;
+        double w0 = 2.0 * M_PI * (highpass ? low_hz : high_hz) / rate;
+        double cw = cos(w0);
+        double alpha = sin(w0) / (2.0 * q[k % 2]);
+        double a0 = 1.0 + alpha;
+        if (highpass) {
+            c->b0[k] = (1.0 + cw) / 2.0 / a0;
+            c->b1[k] = -(1.0 + cw) / a0;
+        } else {
+            c->b0[k] = (1.0 - cw) / 2.0 / a0;
+            c->b1[k] = (1.0 - cw) / a0;
+        }
+        c->b2[k] = c->b0[k];
+        c->a1[k] = -2.0 * cw / a0;
+        c->a2[k] = (1.0 - alpha) / a0;
+    }
+}
+
+// Redesign the prefilter for the current cutoffs. Called from the main thread;
+// the audio thread is only held for the coefficient copy, and the filter state
+// carries over so the output stays continuous
+void update_bandpass(void) {
+    BiquadCoeffs c;
+    design_bandpass(bandpass_low_hz, bandpass_high_hz, SAMPLE_RATE, &c);
+    SDL_LockAudioDevice(deviceId);
+    prefilter.c = c;
+    SDL_UnlockAudioDevice(deviceId);
+}
+
+// Gain ramp for the next chunk, from a look-ahead pass over its samples that
+// also takes the input peak and counts samples clipped at the source.
+// Without AGC both ends are the manual gain.
+void chunk_gain(const Sint16* samples, double* start, double* end) {
+    int peak = 0;
+    int clipped = 0;
+    for (int i = 0; i < CHUNK_SIZE; ++i) {
+        int x = abs(samples[i]);
+        peak = x > peak ? x : peak;
+        clipped += x >= CLIP_LEVEL;
+    }
+    double peak_db = peak > 0 ? fmax(20.0 * log10(peak / MAX_AMPLITUDE), SILENCE_GATE_MIN_DB) : SILENCE_GATE_MIN_DB;
+    input_raw_peak_db = peak_db;
+    input_peak_db = fmax(peak_db + 20.0 * log10(meter_gain()), SILENCE_GATE_MIN_DB);
+    if (clipped > 0) {
+        clipped_samples += clipped;
+        last_clip_time = audio_ticks();
+    }
+    if (!agc_enabled) {
+        chunk_gain_db = input_gain_db;
+        *start = *end = pow(10.0, input_gain_db / 20.0);
+        return;
+    }
+    double chunk_ms = 1000.0 * CHUNK_SIZE / SAMPLE_RATE;
+    double time_ms = peak_db > agc_envelope_db ? agc_attack_ms : agc_release_ms;
+    agc_envelope_db += (peak_db - agc_envelope_db) * (1.0 - exp(-chunk_ms / fmax(time_ms, 1e-3)));
+    double target = fmin(fmax(agc_target_db - agc_envelope_db, AGC_MIN_GAIN_DB), AGC_MAX_GAIN_DB);
+    // Look ahead: neither end of the ramp may lift this chunk past the ceiling
+    double limit = AGC_CEILING_DB - peak_db;
+    double from = agc_gain_db;
+    if (target > limit) {
+        target = limit;
+    }
+    if (from > limit) {
+        from = target;
+    }
+    agc_gain_db = target;
+    *start = pow(10.0, from / 20.0);
+    *end = pow(10.0, target / 20.0);
+    chunk_gain_db = 20.0 * log10(0.5 * (*start + *end)); // Mean amplitude gain over the ramp
+}
+
+// Gain the input level meters are read at: the manual gain, or unity with
+// AGC, so the meters and track levels describe the input, not the AGC
+double meter_gain(void) {
+    return agc_enabled ? 1.0 : pow(10.0, input_gain_db / 20.0);
+}
+
+// Convert a chunk of input into out, ramping the gain from gain_start to
+// gain_end, measuring its RMS level for the meters and counting samples the
+// gain pushes past full scale
+void convert_chunk(const Sint16* samples, double gain_start, double gain_end, double* out) {
+    double scale = gain_start / MAX_AMPLITUDE;
+    double step = (gain_end - gain_start) / MAX_AMPLITUDE / CHUNK_SIZE;
+    double energy = 0.0;
+    int clipped = 0;
+    for (int i = 0; i < CHUNK_SIZE; ++i) {
+        double raw = samples[i];
+        scale += step;
+        double x = raw * scale;
+        out[i] = x;
+        energy += raw * raw;
+        clipped += fabs(x) > 1.0 && fabs(raw) < CLIP_LEVEL;
+    }
+    if (clipped > 0) {
+        clipped_samples += clipped;
+        last_clip_time = audio_ticks();
+    }
+    double meter = meter_gain() / MAX_AMPLITUDE;
+    energy *= meter * meter;
+    input_rms_db = energy > 0.0 ? fmax(10.0 * log10(energy / CHUNK_SIZE), SILENCE_GATE_MIN_DB) : SILENCE_GATE_MIN_DB;
+}
+
+// Decide whether the analysis of the latest chunk can be skipped. The gate
+// closes after SILENCE_GATE_HOLD_CHUNKS quiet chunks with every track slot
+// free, and reopens on the first chunk whose raw peak reaches the floor
+bool silence_gate(void) {
+    gate_chunks++;
+    if (silence_gate_db <= SILENCE_GATE_MIN_DB || input_raw_peak_db >= silence_gate_db) {
+        quiet_chunks = 0;
+        if (gate_closed) {
+            reopen_gate();
+        }
+        return false;
+    }
+    if (quiet_chunks < SILENCE_GATE_HOLD_CHUNKS) {
+        quiet_chunks++;
+    }
+    if (!gate_closed) {
+        if (quiet_chunks < SILENCE_GATE_HOLD_CHUNKS) {
+            return false;
+        }
+        for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+            if (tracks.start_time[i] != 0) {
+                return false;
+            }
+        }
+        gate_closed = true;
+    }
+    gate_skipped++;
+    return true;
+}
+
+// Restart the filters and frame assembly after a skipped stretch, so the
+// first frames are not spliced onto audio from before the silence
+void reopen_gate(void) {
+    gate_closed = false;
+    memset(prefilter.z1, 0, sizeof(prefilter.z1));
+    memset(prefilter.z2, 0, sizeof(prefilter.z2));
+    memset(prefilter.y, 0, sizeof(prefilter.y));
+    configure_decimation(decimation_stages);
+    for (int s = 0; s < LOWBAND_STAGES; ++s) {
+        lowband.stages[s].len = 0;
+    }
+    memset(lowband.filter.z1, 0, sizeof(lowband.filter.z1));
+    memset(lowband.filter.z2, 0, sizeof(lowband.filter.z2));
+    memset(lowband.filter.y, 0, sizeof(lowband.filter.y));
+    lowband.count = 0;
+}
+
+// Run a block through a lockstep biquad cascade; in and out may alias
+void biquad_filter(BiquadCascade* f, const double* in, double* out, int count) {
+    for (int i = 0; i < count; ++i) {
+        double x[BIQUAD_SECTIONS];
+        x[0] = in[i];
+        for (int k = 1; k < BIQUAD_SECTIONS; ++k) {
+            x[k] = f->y[k - 1];
+        }
+        for (int k = 0; k < BIQUAD_SECTIONS; ++k) {
+            double y = f->c.b0[k] * x[k] + f->z1[k];
+            f->z1[k] = f->c.b1[k] * x[k] - f->c.a1[k] * y + f->z2[k];
+            f->z2[k] = f->c.b2[k] * x[k] - f->c.a2[k] * y;
+            f->y[k] = y;
+        }
+        out[i] = f->y[BIQUAD_SECTIONS - 1];
+    }
+}
+
+// --- Low-band Pitch ---
+bool setup_lowband(void) {
+    memset(&lowband, 0, sizeof(lowband));
+    double rate = (double)SAMPLE_RATE / (1 << LOWBAND_STAGES);
+    design_bandpass(LOWBAND_HIGHPASS_HZ, LOWBAND_CUTOFF_HZ, rate, &lowband.filter.c);
+    lowband.x = fftw_malloc(sizeof(double) * LOWBAND_FFT);
+    lowband.y = fftw_malloc(sizeof(double) * LOWBAND_FFT);
+    lowband.r = fftw_malloc(sizeof(double) * LOWBAND_FFT);
+    lowband.x_spec = fftw_malloc(sizeof(fftw_complex) * (LOWBAND_FFT / 2 + 1));
+    lowband.y_spec = fftw_malloc(sizeof(fftw_complex) * (LOWBAND_FFT / 2 + 1));
+    if (!lowband.x || !lowband.y || !lowband.r || !lowband.x_spec || !lowband.y_spec) {
+        log_error("FFTW memory allocation failed for the low-band pitch path.");
+        return false;
+    }
+    lowband.x_plan = fftw_plan_dft_r2c_1d(LOWBAND_FFT, lowband.x, lowband.x_spec, FFTW_ESTIMATE);
+    lowband.y_plan = fftw_plan_dft_r2c_1d(LOWBAND_FFT, lowband.y, lowband.y_spec, FFTW_ESTIMATE);
+    lowband.r_plan = fftw_plan_dft_c2r_1d(LOWBAND_FFT, lowband.y_spec, lowband.r, FFTW_ESTIMATE);
+    return true;
+}
+
+// The YIN path covers the low band while the FFT bins are too coarse for it
+bool lowband_active(void) {
+    return freq_resolution > LOWBAND_FFT_RESOLUTION_HZ && bandpass_low_hz < LOWBAND_MAX_HZ && !fixed_path_active();
+}
+
+// Decimate a prefiltered full-rate chunk into the low-band history
+void lowband_push(const double* chunk) {
+    double block[CHUNK_SIZE];
+    memcpy(block, chunk, sizeof(block));
+    int count = CHUNK_SIZE;
+    for (int s = 0; s < LOWBAND_STAGES; ++s) {
+        count = halfband_decimate(&lowband.stages[s], block, count, block);
+    }
+    biquad_filter(&lowband.filter, block, block, count);
+    if (count >= LOWBAND_LENGTH) {
+        memcpy(lowband.samples, block + count - LOWBAND_LENGTH, sizeof(lowband.samples));
+        lowband.count = LOWBAND_LENGTH;
+        return;
+    }
+    int keep = LOWBAND_LENGTH - count;
+    memmove(lowband.samples, lowband.samples + count, sizeof(double) * keep);
+    memcpy(lowband.samples + keep, block, sizeof(double) * count);
+    lowband.count = lowband.count + count > LOWBAND_LENGTH ? LOWBAND_LENGTH : lowband.count + count;
+}
+
+// YIN over the low-band history. The difference function
+// d(tau) = sum (x[j] - x[j+tau])^2 over the window is expanded into two
+// energy terms from running sums and a cross-correlation computed with
+// one pair of FFTs, so every lag costs O(1) after O(N log N) set-up.
+// Returns true with the period's frequency, periodicity (1 - CMNDF) and
+// the RMS level over the window.
+bool lowband_pitch(double* freq, double* periodicity, double* rms) {
+    if (lowband.count < LOWBAND_LENGTH) {
+        return false;
+    }
+    const double* x = lowband.samples;
+    double energy[LOWBAND_LENGTH + 1];
+    energy[0] = 0.0;
+    for (int j = 0; j < LOWBAND_LENGTH; ++j) {
+        energy[j + 1] = energy[j] + x[j] * x[j];
+    }
+    if (energy[LOWBAND_WINDOW] < LOWBAND_MIN_RMS * LOWBAND_MIN_RMS * LOWBAND_WINDOW) {
+        return false;
+    }
+
+    memset(lowband.x, 0, sizeof(double) * LOWBAND_FFT);
+    memset(lowband.y, 0, sizeof(double) * LOWBAND_FFT);
+    memcpy(lowband.x, x, sizeof(double) * LOWBAND_LENGTH);
+    memcpy(lowband.y, x, sizeof(double) * LOWBAND_WINDOW);
+    fftw_execute(lowband.x_plan);
+    // A louder tone above the band still leaks through the low-pass, and
+    // YIN would accept a multiple of its period as a subharmonic pitch, so
+    // most of the energy must lie in the band itself
+    double rate = (double)SAMPLE_RATE / (1 << LOWBAND_STAGES);
+    int edge = (int)ceil(LOWBAND_MAX_HZ * LOWBAND_FFT / rate);
+    double in_band = 0.0, total = 0.0;
+    for (int k = 1; k <= LOWBAND_FFT / 2; ++k) {
+        double p = lowband.x_spec[k][0] * lowband.x_spec[k][0] + lowband.x_spec[k][1] * lowband.x_spec[k][1];
+        total += p;
+        in_band += k <= edge ? p : 0.0;
+    }
+    if (in_band < LOWBAND_ENERGY_FRACTION * total) {
+        return false;
+    }
+    fftw_execute(lowband.y_plan);
+    for (int k = 0; k <= LOWBAND_FFT / 2; ++k) {
+        double xr = lowband.x_spec[k][0], xi = lowband.x_spec[k][1];
+        double yr = lowband.y_spec[k][0], yi = lowband.y_spec[k][1];
+        lowband.y_spec[k][0] = xr * yr + xi * yi; // X * conj(Y)
+        lowband.y_spec[k][1] = xi * yr - xr * yi;
+    }
+    fftw_execute(lowband.r_plan); // r[tau] = LOWBAND_FFT * sum x[j] x[j+tau]
+
+    int min_lag = (int)floor(rate / LOWBAND_MAX_HZ);
+    double diff[LOWBAND_MAX_LAG + 2];
+    double cmndf[LOWBAND_MAX_LAG + 2];
+    double running = 0.0;
+    diff[0] = 0.0;
+    cmndf[0] = 1.0;
+    for (int tau = 1; tau <= LOWBAND_MAX_LAG + 1 && tau < LOWBAND_LENGTH - LOWBAND_WINDOW + 1; ++tau) {
+        double d = energy[LOWBAND_WINDOW] + (energy[tau + LOWBAND_WINDOW] - energy[tau]) -
+                   2.0 * lowband.r[tau] / LOWBAND_FFT;
+        diff[tau] = d;
+        running += d;
+        cmndf[tau] = running > 0.0 ? d * tau / running : 1.0;
+    }
+    for (int tau = min_lag; tau < LOWBAND_MAX_LAG; ++tau) {
+        if (cmndf[tau] >= YIN_THRESHOLD) {
+            continue;
+        }
+        while (tau + 1 < LOWBAND_MAX_LAG && cmndf[tau + 1] < cmndf[tau]) {
+            tau++;
+        }
+        // Refine the period on the raw difference function, which is not
+        // skewed by the cumulative-mean normalisation
+        double a = diff[tau - 1], b = diff[tau], c = diff[tau + 1];
+        double denom = a - 2.0 * b + c;
+        double shift = denom > 0.0 ? 0.5 * (a - c) / denom : 0.0;
+        *freq = rate / (tau + shift);
+        *periodicity = 1.0 - cmndf[tau];
+        *rms = sqrt(energy[LOWBAND_WINDOW] / LOWBAND_WINDOW);
+        return true;
+    }
+    return false;
+}
+
+// Accumulate the time spent since *mark into the given stage when benchmarking
+void stage_mark(int stage, Uint64* mark) {
+    if (!bench_mode) {
+        return;
+    }
+    Uint64 t = SDL_GetPerformanceCounter();
+    stage_ticks[stage] += t - *mark;
+    *mark = t;
+}
+
+// Millisecond clock for track ageing: wall time when live, stream time in
+// the benchmark so persistence and hold behave as they would in real time
+Uint32 audio_ticks(void) {
+    if (bench_mode) {
+        return (Uint32)(bench_samples * 1000 / SAMPLE_RATE);
+    }
+    return SDL_GetTicks();
+}
+
+// --- Headless Benchmark ---
+// Generates a synthetic detection workload (steady tones, one of them clipped, a slow sweep, noise
+// and idle stretches) and runs it through audio_callback, printing the mean
+// time per frame for each pipeline stage. The same run is used as the training
+// workload for the profile-guided build (see `make pgo`).
+int run_benchmark(int frames, int mode) {
+    if (SDL_Init(0) < 0) {
+        log_error("Failed to initialize SDL");
+        return 1;
+    }
+    if (!setup_fft()) {
+        cleanup();
+        return 1;
+    }
+    bench_mode = true;
+    analysis_mode = mode;
+    memset(stage_ticks, 0, sizeof(stage_ticks));
+    bench_samples = 0;
+    gate_chunks = gate_skipped = 0;
+    clipped_samples = 0;
+    full_scans = tracked_frames = tracked_bins = 0;
+    double gain_min = HUGE_VAL, gain_max = -HUGE_VAL, gain_sum = 0.0;
+
+    static Sint16 chunk[CHUNK_SIZE];
+    const double tone_hz[3] = {440.0, 1000.0, 3700.0};
+    const double tone_amp[3] = {0.30, 0.20, 0.10};
+    double phase[4] = {0.0, 0.0, 0.0, 0.0};
+    Uint32 noise = 22222;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int f = 0; f < frames; ++f) {
+        bool idle = (f / 50) % 8 == 7; // every eighth block of frames is dither only
+        double sweep_hz = 2000.0 + 1500.0 * sin(2.0 * M_PI * f / 400.0);
+        for (int i = 0; i < CHUNK_SIZE; ++i) {
+            double v = 0.0;
+            if (!idle) {
+                for (int t = 0; t < 3; ++t) {
+                    double s = sin(phase[t]);
+                    if (t == 1) {
+                        s = tanh(3.0 * s) / tanh(3.0); // soft-clipped tone with odd harmonics
+                    }
+                    v += tone_amp[t] * s;
+                    phase[t] += 2.0 * M_PI * tone_hz[t] / SAMPLE_RATE;
+                }
+                v += 0.10 * sin(phase[3]);
+                phase[3] += 2.0 * M_PI * sweep_hz / SAMPLE_RATE;
+            }
+            noise = noise * 1664525u + 1013904223u;
+            v += (idle ? 2.0 / MAX_AMPLITUDE : 0.01) * ((double)(noise >> 8) / (double)(1u << 24) - 0.5);
+            chunk[i] = (Sint16)lrint(v * (MAX_AMPLITUDE - 1.0));
+        }
+        bench_samples += CHUNK_SIZE;
+        for (int t = 0; t < 4; ++t) {
+            phase[t] = fmod(phase[t], 2.0 * M_PI);
+        }
+        audio_callback(NULL, (Uint8*)chunk, (int)sizeof(chunk));
+        gain_min = fmin(gain_min, chunk_gain_db);
+        gain_max = fmax(gain_max, chunk_gain_db);
+        gain_sum += chunk_gain_db;
+    }
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+
+    double us_per_tick = 1e6 / (double)SDL_GetPerformanceFrequency();
+    printf("# %d frames of %d samples, %s mode, %s%s spectrum (%s window, %dx padding, %dx overlap), %s detector, integration %s\n",
+           frames, CHUNK_SIZE, analysis_mode_names[mode], fixed_path_active() ? "fixed-point " : "",
+           spectral_mode_names[spectral_mode], window_names[window_type], zero_pad, frame_overlap,
+           detector_mode_names[detector_mode], integration_mode_names[integration_mode]);
+    Uint64 pipeline = 0;
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        printf("%-10s %10.3f\n", stage_names[s], stage_ticks[s] * us_per_tick / frames);
+        pipeline += stage_ticks[s];
+    }
+    printf("%-10s %10.3f\n", "pipeline", pipeline * us_per_tick / frames);
+    printf("# %.3f us/frame including signal synthesis\n", elapsed * us_per_tick / frames);
+    printf("# %s gain %.1f dB mean, %.1f to %.1f dB, %llu samples clipped\n", agc_enabled ? "AGC" : "manual",
+           gain_sum / frames, gain_min, gain_max, (unsigned long long)clipped_samples);
+    if (mode == ANALYSIS_SINE) {
+        printf("# silence gate at %.0f dBFS skipped %.1f%% of chunks\n", silence_gate_db,
+               gate_chunks > 0 ? 100.0 * gate_skipped / gate_chunks : 0.0);
+    }
+    if (tracked_search) {
+        printf("# tracked search: %llu full scans, %llu tracked frames searching %.0f of %d bins on average\n",
+               (unsigned long long)full_scans, (unsigned long long)tracked_frames,
+               tracked_frames > 0 ? (double)tracked_bins / tracked_frames : 0.0, FFT_SIZE / 2);
+    }
+    for (int i = 0; i < MAX_TRACKED_SINES; ++i) {
+        if (tracks.active[i]) {
+            printf("# track %d: %.2f Hz (%.2f%% purity, %.1f dBFS, peak %.1f dBFS, SNR %.1f dB, %d harmonics)\n", i,
+                   tracks.freq[i], tracks.purity[i], tracks.level_db[i], tracks.peak_db[i], tracks.snr_db[i], tracks.harmonics[i]);
+            if (demods[i].start_time == tracks.start_time[i] && demods[i].count > 0) {
+                printf("#   demod: FM %.2f Hz rms (%.2f Hz peak), %d dropouts\n", demods[i].fm_rms_hz, demods[i].fm_peak_hz,
+                       demods[i].dropouts);
+            } else if (demods[i].start_time == tracks.start_time[i] && demods[i].crowded) {
+                printf("#   demod: crowded, %d dropouts before\n", demods[i].dropouts);
+            }
+        }
+    }
+    bench_mode = false;
+    cleanup();
+    return 0;
+}
+
+// Time single- and multi-threaded real FFT plans from 16k to 1M points.
+// Each row gives microseconds per transform for 1, 2, 4 ... threads and the
+// core count itself; the suggested threshold is the smallest size from which
+// two threads win at every larger size.
+// Thread counts of the sweep: powers of two, then the core count when it
+// is not one
+int next_thread_count(int threads, int cores) {
+    return threads < cores && threads * 2 > cores ? cores : threads * 2;
+}
+
+int run_fft_benchmark(void) {
+    if (SDL_Init(0) < 0) {
+        log_error("Failed to initialize SDL");
+        return 1;
+    }
+    if (!fftw_init_threads()) {
+        log_error("FFTW thread support unavailable.");
+        SDL_Quit();
+        return 1;
+    }
+    int cores = SDL_GetCPUCount();
+    int max_n = 1 << FFT_BENCH_MAX_LOG2;
+    double* in = fftw_malloc(sizeof(double) * max_n);
+    fftw_complex* spec = fftw_malloc(sizeof(fftw_complex) * (max_n / 2 + 1));
+    if (!in || !spec) {
+        log_error("FFTW memory allocation failed for the FFT benchmark.");
+        fftw_free(in);
+        fftw_free(spec);
+        fftw_cleanup_threads();
+        SDL_Quit();
+        return 1;
+    }
+    Uint32 noise = 22222;
+    for (int i = 0; i < max_n; ++i) {
+        noise = noise * 1664525u + 1013904223u;
+        in[i] = (double)(noise >> 8) / (double)(1u << 24) - 0.5;
+    }
+
+    printf("# real FFT, us per transform by thread count (%d cores)\n", cores);
+    printf("%-8s", "size");
+    for (int t = 1; t <= cores; t = next_thread_count(t, cores)) {
+        printf(" %10d", t);
+    }
+    printf("\n");
+    double freq = (double)SDL_GetPerformanceFrequency();
+    int suggested = 0;
+    for (int lg = FFT_BENCH_MIN_LOG2; lg <= FFT_BENCH_MAX_LOG2; ++lg) {
+        int n = 1 << lg;
+        double single = 0.0;
+        bool threads_win = false;
+        printf("%-8d", n);
+        for (int t = 1; t <= cores; t = next_thread_count(t, cores)) {
+            fftw_plan_with_nthreads(t);
+            fftw_plan plan = fftw_plan_dft_r2c_1d(n, in, spec, FFTW_ESTIMATE);
+            fftw_execute(plan); // Warm the caches and the thread pool
+            int runs = 0;
+            Uint64 start = SDL_GetPerformanceCounter();
+            Uint64 elapsed;
+            do {
+                fftw_execute(plan);
+                runs++;
+                elapsed = SDL_GetPerformanceCounter() - start;
+            } while (elapsed < FFT_BENCH_SECONDS * freq);
+            fftw_destroy_plan(plan);
+            double us = elapsed * 1e6 / freq / runs;
+            if (t == 1) {
+                single = us;
+            } else if (t == 2) {
+                threads_win = us < single;
+            }
+            printf(" %10.1f", us);
+        }
+        printf("\n");
+        if (!threads_win) {
+            suggested = 0;
+        } else if (suggested == 0) {
+            suggested = n;
+        }
+    }
+    if (cores < 2) {
+        printf("# single core: multithreaded plans cannot help\n");
+    } else if (suggested > 0) {
+        printf("# suggested fft_threads_min_size=%d\n", suggested);
+    } else {
+        printf("# threads never won up to %d points; keep transforms single-threaded\n", max_n);
+    }
+    fftw_free(in);
+    fftw_free(spec);
+    fftw_cleanup_threads();
+    SDL_Quit();
+    return 0;
+}
+
+// Compare the integer periodogram with the floating-point one on the same
+// samples: for every window, and for Kaiser windows with a low beta whose
+// Q15 copy must be scaled down, print the peak power error and the worst
+// error in any other bin relative to the tone, for a full-scale and a quiet
+// tone. Then time both paths per frame.
+int run_fixed_benchmark(int frames) {
+    if (SDL_Init(0) < 0) {
+        log_error("Failed to initialize SDL");
+        return 1;
+    }
+    if (!setup_fft()) {
+        cleanup();
+        return 1;
+    }
+    static Sint16 loud[FFT_SIZE], quiet[FFT_SIZE];
+    double quiet_amp = (MAX_AMPLITUDE - 1.0) * pow(10.0, FIXED_BENCH_QUIET_DB / 20.0);
+    for (int i = 0; i < FFT_SIZE; ++i) {
+        double s = sin(2.0 * M_PI * FIXED_BENCH_HZ * i / SAMPLE_RATE);
+        loud[i] = (Sint16)lrint((MAX_AMPLITUDE - 1.0) * s);
+        quiet[i] = (Sint16)lrint(quiet_amp * s);
+    }
+
+    printf("# fixed vs float periodogram, %.1f Hz tone: peak error (dB) and worst other-bin error (dB below the tone)\n",
+           FIXED_BENCH_HZ);
+    printf("%-16s %10s %10s %10s %10s\n", "window", "peak 0", "other 0", "peak -61", "other -61");
+    const double low_betas[2] = {1.0, 4.0};
+    double configured_beta = kaiser_beta;
+    int configured_window = window_type;
+    for (int row = 0; row < WINDOW_COUNT + 2; ++row) {
+        char name[32];
+        if (row < WINDOW_COUNT) {
+            window_type = row;
+            snprintf(name, sizeof(name), "%s", window_names[row]);
+        } else {
+            window_type = WINDOW_KAISER;
+            kaiser_beta = low_betas[row - WINDOW_COUNT];
+            setup_windows();
+            setup_fixed_point();
+            snprintf(name, sizeof(name), "kaiser b=%.1f", kaiser_beta);
+        }
+        double peak_loud, other_loud, peak_quiet, other_quiet;
+        fixed_bench_errors(loud, &peak_loud, &other_loud);
+        fixed_bench_errors(quiet, &peak_quiet, &other_quiet);
+        printf("%-16s %10.4f %10.1f %10.4f %10.1f\n", name, peak_loud, other_loud, peak_quiet, other_quiet);
+    }
+    kaiser_beta = configured_beta;
+    setup_windows();
+    setup_fixed_point();
+    window_type = configured_window;
+
+    // Both paths from Sint16 samples to bin powers in the same units
+    double level_scale = 1.0 / MAX_AMPLITUDE;
+    double gain_ratio = 0.5 / window_info[window_type].coherent_gain;
+    double power_scale = gain_ratio * gain_ratio;
+    const double* window = window_tables[window_type];
+    double powers[FFT_SIZE / 2];
+    double checksum = 0.0;
+    double freq = (double)SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int f = 0; f < frames; ++f) {
+        fixed_spectrum(loud, level_scale, powers);
+        checksum += powers[f % (FFT_SIZE / 2)];
+    }
+    double fixed_us = (SDL_GetPerformanceCounter() - start) * 1e6 / freq / frames;
+    start = SDL_GetPerformanceCounter();
+    for (int f = 0; f < frames; ++f) {
+        for (int i = 0; i < FFT_SIZE; ++i) {
+            pcm_buffer[i] = loud[i] * level_scale * window[i];
+        }
+        fftw_execute(p);
+        for (int k = 0; k < FFT_SIZE / 2; ++k) {
+            powers[k] = (out[k][0] * out[k][0] + out[k][1] * out[k][1]) * power_scale;
+        }
+        checksum -= powers[f % (FFT_SIZE / 2)];
+    }
+    double float_us = (SDL_GetPerformanceCounter() - start) * 1e6 / freq / frames;
+    printf("# %s window, us per frame over %d frames: fixed %.2f, float %.2f (checksum %.3g)\n",
+           window_names[window_type], frames, fixed_us, float_us, checksum);
+    cleanup();
+    return 0;
+}
+
+// Feed the same Gaussian white noise through every spectral estimator and
+// print the bin-to-bin coefficient of variation of its noise powers (standard
+// deviation over mean within a frame, averaged over frames). A single
+// periodogram bin is exponentially distributed, so it reads close to 1.
+int run_variance_benchmark(int frames) {
+    if (SDL_Init(0) < 0) {
+        log_error("Failed to initialize SDL");
+        return 1;
+    }
+    if (!setup_fft()) {
+        cleanup();
+        return 1;
+    }
+    printf("# noise CV over bins %d..%d, %d frames of white noise\n", VARIANCE_BENCH_EDGE,
+           FFT_SIZE / 2 - VARIANCE_BENCH_EDGE - 1, frames);
+    static double frame[FFT_SIZE];
+    double powers[FFT_SIZE / 2];
+    double gain_ratio = 0.5 / window_info[window_type].coherent_gain;
+    for (int m = 0; m < SPECTRUM_MODE_COUNT; ++m) {
+        Uint32 noise = 22222;
+        double cv_sum = 0.0;
+        // The polyphase channelizer needs its history filled first
+        for (int f = -POLYPHASE_TAPS; f < frames; ++f) {
+            for (int i = 0; i < FFT_SIZE; ++i) {
+                noise = noise * 1664525u + 1013904223u;
+                double u1 = ((noise >> 8) + 0.5) / (double)(1u << 24);
+                noise = noise * 1664525u + 1013904223u;
+                double u2 = (noise >> 8) / (double)(1u << 24);
+                frame[i] = 0.01 * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+            }
+            double scale = gain_ratio * gain_ratio;
+            if (m == SPECTRUM_POLYPHASE) {
+                polyphase_frame(frame);
+                scale = polyphase.scale;
+            } else if (m == SPECTRUM_PERIODOGRAM) {
+                for (int i = 0; i < FFT_SIZE; ++i) {
+                    pcm_buffer[i] = frame[i] * window_tables[window_type][i];
+                }
+            } else {
+                estimate_tapered_spectrum(&taper_banks[m], frame, powers);
+            }
+            if (m == SPECTRUM_POLYPHASE || m == SPECTRUM_PERIODOGRAM) {
+                fftw_execute(p);
+                for (int k = 0; k < FFT_SIZE / 2; ++k) {
+                    powers[k] = (out[k][0] * out[k][0] + out[k][1] * out[k][1]) * scale;
+                }
+            }
+            if (f < 0) {
+                continue;
+            }
+            double sum = 0.0, sum_sq = 0.0;
+            int n = 0;
+            for (int k = VARIANCE_BENCH_EDGE; k < FFT_SIZE / 2 - VARIANCE_BENCH_EDGE; ++k) {
+                sum += powers[k];
+                sum_sq += powers[k] * powers[k];
+                n++;
+            }
+            double mean = sum / n;
+            cv_sum += sqrt(fmax(0.0, sum_sq / n - mean * mean)) / mean;
+        }
+        printf("%-12s %6.3f\n", spectral_mode_names[m], cv_sum / frames);
+    }
+    cleanup();
+    return 0;
+}
+
+// Error of the integer periodogram of one frame against the floating-point
+// one under the current window: the peak bin's power ratio in dB, and the
+// largest magnitude difference in any other bin in dB relative to the peak.
+// Comparing magnitudes rather than powers keeps a tiny relative error in the
+// tone's main lobe from reading as a large one.
+void fixed_bench_errors(const Sint16* samples, double* peak_db, double* other_db) {
+    double level_scale = 1.0 / MAX_AMPLITUDE;
+    double gain_ratio = 0.5 / window_info[window_type].coherent_gain;
+    const double* window = window_tables[window_type];
+    for (int i = 0; i < FFT_SIZE; ++i) {
+        pcm_buffer[i] = samples[i] * level_scale * window[i];
+    }
+    fftw_execute(p);
+    double fixed[FFT_SIZE / 2];
+    fixed_spectrum(samples, level_scale, fixed);
+
+    double reference[FFT_SIZE / 2];
+    int peak = 0;
+    for (int k = 0; k < FFT_SIZE / 2; ++k) {
+        reference[k] = (out[k][0] * out[k][0] + out[k][1] * out[k][1]) * gain_ratio * gain_ratio;
+        if (reference[k] > reference[peak]) {
+            peak = k;
+        }
+    }
+    double worst = 0.0;
+    for (int k = 0; k < FFT_SIZE / 2; ++k) {
+        if (k != peak) {
+            worst = fmax(worst, fabs(sqrt(fixed[k]) - sqrt(reference[k])));
+        }
+    }
+    *peak_db = 10.0 * log10(fixed[peak] / reference[peak]);
+    *other_db = worst > 0.0 ? 20.0 * log10(sqrt(reference[peak]) / worst) : HUGE_VAL;
+}
+
+// --- Helper Functions ---
+void add_log_line(const char* text, SDL_Color color, Uint32 expire_time, int track_id) {
+    SDL_LockAudioDevice(deviceId); // Prevent race condition with audio thread
     if (log_count < MAX_LOG_LINES) {
         strncpy(log_entries[log_count].text, text, sizeof(log_entries[log_count].text) - 1);
         log_entries[log_count].text[sizeof(log_entries[log_count].text) - 1] = '\0';
@@ -634,11 +4609,28 @@ void save_config(void) {
     }
     fprintf(f, "persistence_threshold_ms=%d\n", persistence_threshold_ms);
     fprintf(f, "input_gain_db=%.2f\n", input_gain_db);
+    fprintf(f, "agc_enabled=%d\n", agc_enabled ? 1 : 0);
+    fprintf(f, "agc_target_db=%.1f\n", agc_target_db);
+    fprintf(f, "agc_attack_ms=%.1f\n", agc_attack_ms);
+    fprintf(f, "agc_release_ms=%.1f\n", agc_release_ms);
     fprintf(f, "bandpass_low_hz=%.2f\n", bandpass_low_hz);
     fprintf(f, "bandpass_high_hz=%.2f\n", bandpass_high_hz);
     fprintf(f, "averaging_enabled=%d\n", averaging_enabled ? 1 : 0);
     fprintf(f, "squelch_enabled=%d\n", squelch_enabled ? 1 : 0);
     fprintf(f, "squelch_threshold=%.2f\n", squelch_threshold);
+    fprintf(f, "analysis_mode=%d\n", analysis_mode);
+    fprintf(f, "spectral_mode=%d\n", spectral_mode);
+    fprintf(f, "detector_mode=%d\n", detector_mode);
+    fprintf(f, "window_type=%d\n", window_type);
+    fprintf(f, "kaiser_beta=%.2f\n", kaiser_beta);
+    fprintf(f, "zero_pad=%d\n", zero_pad);
+    fprintf(f, "frame_overlap=%d\n", frame_overlap);
+    fprintf(f, "fixed_point=%d\n", fixed_point ? 1 : 0);
+    fprintf(f, "integration_mode=%d\n", integration_mode);
+    fprintf(f, "tracked_search=%d\n", tracked_search ? 1 : 0);
+    fprintf(f, "demod_enabled=%d\n", demod_enabled ? 1 : 0);
+    fprintf(f, "fft_threads_min_size=%d\n", fft_threads_min_size);
+    fprintf(f, "silence_gate_db=%.1f\n", silence_gate_db);
     fclose(f);
 }
 
@@ -655,6 +4647,21 @@ void load_config(void) {
             persistence_threshold_ms = i;
         } else if (sscanf(line, "input_gain_db=%lf", &d) == 1) {
             input_gain_db = d;
+            agc_gain_db = d;
+        } else if (sscanf(line, "agc_enabled=%d", &i) == 1) {
+            agc_enabled = i ? true : false;
+        } else if (sscanf(line, "agc_target_db=%lf", &d) == 1) {
+            if (d <= AGC_CEILING_DB) {
+                agc_target_db = d;
+            }
+        } else if (sscanf(line, "agc_attack_ms=%lf", &d) == 1) {
+            if (d >= 0.0) {
+                agc_attack_ms = d;
+            }
+        } else if (sscanf(line, "agc_release_ms=%lf", &d) == 1) {
+            if (d >= 0.0) {
+                agc_release_ms = d;
+            }
         } else if (sscanf(line, "bandpass_low_hz=%lf", &d) == 1) {
             bandpass_low_hz = d;
         } else if (sscanf(line, "bandpass_high_hz=%lf", &d) == 1) {
@@ -665,6 +4672,48 @@ void load_config(void) {
             squelch_enabled = i ? true : false;
         } else if (sscanf(line, "squelch_threshold=%lf", &d) == 1) {
             squelch_threshold = d;
+        } else if (sscanf(line, "spectral_mode=%d", &i) == 1) {
+            if (i >= 0 && i < SPECTRUM_MODE_COUNT) {
+                spectral_mode = i;
+            }
+        } else if (sscanf(line, "analysis_mode=%d", &i) == 1) {
+            if (i >= 0 && i < ANALYSIS_MODE_COUNT) {
+                analysis_mode = i;
+            }
+        } else if (sscanf(line, "detector_mode=%d", &i) == 1) {
+            if (i >= 0 && i < DETECTOR_MODE_COUNT) {
+                detector_mode = i;
+            }
+        } else if (sscanf(line, "window_type=%d", &i) == 1) {
+            if (i >= 0 && i < WINDOW_COUNT) {
+                window_type = i;
+            }
+        } else if (sscanf(line, "kaiser_beta=%lf", &d) == 1) {
+            if (d > 0.0) {
+                kaiser_beta = d;
+            }
+        } else if (sscanf(line, "zero_pad=%d", &i) == 1) {
+            zero_pad = i; // validated once the padded plans exist
+        } else if (sscanf(line, "fft_threads_min_size=%d", &i) == 1) {
+            if (i > 0) {
+                fft_threads_min_size = i;
+            }
+        } else if (sscanf(line, "fixed_point=%d", &i) == 1) {
+            fixed_point = i ? true : false;
+        } else if (sscanf(line, "integration_mode=%d", &i) == 1) {
+            if (i >= 0 && i < INTEGRATION_MODE_COUNT) {
+                integration_mode = i;
+            }
+        } else if (sscanf(line, "tracked_search=%d", &i) == 1) {
+            tracked_search = i ? true : false;
+        } else if (sscanf(line, "demod_enabled=%d", &i) == 1) {
+            demod_enabled = i ? true : false;
+        } else if (sscanf(line, "frame_overlap=%d", &i) == 1) {
+            frame_overlap = i; // validated once the batched plans exist
+        } else if (sscanf(line, "silence_gate_db=%lf", &d) == 1) {
+            if (d >= SILENCE_GATE_MIN_DB && d <= 0.0) {
+                silence_gate_db = d;
+            }
         }
     }
     fclose(f);
@@ -691,6 +4740,56 @@ void cleanup() {
         fftw_destroy_plan(p);
         fftw_free(out);
     }
+    for (int i = 1; i < ZERO_PAD_PLANS; ++i) {
+        if (padded_plans[i]) {
+            fftw_destroy_plan(padded_plans[i]);
+            padded_plans[i] = NULL;
+        }
+    }
+    if (lowband.x_plan) {
+        fftw_destroy_plan(lowband.x_plan);
+        fftw_destroy_plan(lowband.y_plan);
+        fftw_destroy_plan(lowband.r_plan);
+    }
+    fftw_free(lowband.x);
+    fftw_free(lowband.y);
+    fftw_free(lowband.r);
+    fftw_free(lowband.x_spec);
+    fftw_free(lowband.y_spec);
+    memset(&lowband, 0, sizeof(lowband));
+    fftw_free(padded_in);
+    fftw_free(padded_out);
+    padded_in = NULL;
+    padded_out = NULL;
+    for (int b = 0; b < FRAME_OVERLAP_MAX; ++b) {
+        if (batch_plans[b]) {
+            fftw_destroy_plan(batch_plans[b]);
+            batch_plans[b] = NULL;
+        }
+    }
+    fftw_free(batch_in);
+    fftw_free(batch_out);
+    batch_in = NULL;
+    batch_out = NULL;
+    free(polyphase.prototype);
+    free(polyphase.history);
+    memset(&polyphase, 0, sizeof(polyphase));
+    for (int m = 0; m < SPECTRUM_MODE_COUNT; ++m) {
+        TaperBank* bank = &taper_banks[m];
+        if (bank->plan) {
+            fftw_destroy_plan(bank->plan);
+        }
+        fftw_free(bank->in);
+        fftw_free(bank->out);
+        free(bank->window);
+        memset(bank, 0, sizeof(*bank));
+    }
+    // Only after the last plan is destroyed: FFTW leaves plans undefined
+    // once the thread state is gone
+    if (fft_threads_ready) {
+        fftw_cleanup_threads();
+        fft_threads_ready = false;
+    }
     if (font) {
         TTF_CloseFont(font);
     }